@@ -8,6 +8,8 @@
 #include "SceneManager.h"
 #include "World.h"
 #include "FluidSystem.h"
+#include "Profiler.h"
+#include "TraceRecorder.h"
 
 void InitApplication(int width, int height, float worldHeight)
 {
@@ -18,6 +20,8 @@ void InitApplication(int width, int height, float worldHeight)
 	gVars->pSceneManager = new CSceneManager();
 	gVars->pPhysicEngine = new CPhysicEngine();
 	gVars->pFluidSystem = new CFluidSystem();
+	gVars->pProfiler = new CProfiler();
+	gVars->pTraceRecorder = new CTraceRecorder();
 
 	gVars->bDebug = false;
 }
@@ -25,6 +29,9 @@ void InitApplication(int width, int height, float worldHeight)
 void RunApplication()
 {
 	gVars->pRenderWindow->Init();
+
+	// flush pending trace on exit
+	gVars->pTraceRecorder->Stop();
 }
 
 #endif
\ No newline at end of file
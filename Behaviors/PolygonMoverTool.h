@@ -48,6 +48,7 @@ class CPolygonMoverTool : public CBehavior
 				if (m_translate)
 				{
 					m_selectedPoly->position += mousePoint - m_prevMousePos;
+					m_selectedPoly->SetAwake(true);
 
 					m_selectedPoly->angularVelocity = 0.0f;
 					m_selectedPoly->speed = Vec2();
@@ -58,11 +59,18 @@ class CPolygonMoverTool : public CBehavior
 					Vec2 to = mousePoint - m_selectedPoly->position;
 
 					m_selectedPoly->rotation.SetAngle(m_clickAngle + from.Angle(to)); 
+					m_selectedPoly->SetAwake(true);
 
 					m_selectedPoly->angularVelocity = 0.0f;
 					m_selectedPoly->speed = Vec2();
 				}
 
+				// bodies resting on it or hit by it, static bodies never reach the narrowphase with sleeping ones
+				if (m_selectedPoly->density == 0.0f)
+				{
+					gVars->pPhysicEngine->WakeBodiesInAABB(m_selectedPoly->aabb.Merge(m_selectedPoly->ComputeAABB()));
+				}
+
 				m_prevMousePos = mousePoint;
 			}
 		}
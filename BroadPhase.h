@@ -6,6 +6,8 @@
 class IBroadPhase
 {
 public:
+	virtual ~IBroadPhase() = default;
+
 	virtual void GetCollidingPairsToCheck(std::vector<SPolygonPair>& pairsToCheck) = 0;
 };
 
@@ -0,0 +1,504 @@
+#include "BroadPhaseAABBTree.h"
+
+#include "Polygon.h"
+#include "GlobalVariables.h"
+#include "World.h"
+
+void CBroadPhaseAABBTree::GetCollidingPairsToCheck(std::vector<SPolygonPair>& pairsToCheck)
+{
+	UpdateProxies();
+	FindNewPairs();
+	ValidatePairs(pairsToCheck);
+}
+
+// Removing a polygon moves the last one of the world to its index : proxies of removed
+// polygons are destroyed, the ones of moved polygons follow them
+void CBroadPhaseAABBTree::ReleaseStaleProxies()
+{
+	size_t polyCount = gVars->pWorld->GetPolygonCount();
+
+	m_relocatedProxies.clear();
+	for (size_t index = 0; index < m_polyProxies.size(); ++index)
+	{
+		int proxy = m_polyProxies[index];
+		if (proxy == NULL_TREE_NODE)
+		{
+			continue;
+		}
+
+		const CPolygonPtr& poly = m_nodes[proxy].poly;
+		size_t polyIndex = poly->GetIndex();
+		if (polyIndex == index && index < polyCount && gVars->pWorld->GetPolygon(index) == poly)
+		{
+			continue;
+		}
+
+		if (polyIndex < polyCount && gVars->pWorld->GetPolygon(polyIndex) == poly)
+		{
+			m_relocatedProxies.push_back(proxy);
+		}
+		else
+		{
+			DestroyProxy(proxy);
+		}
+		m_polyProxies[index] = NULL_TREE_NODE;
+	}
+
+	m_polyProxies.resize(polyCount, NULL_TREE_NODE);
+	for (int proxy : m_relocatedProxies)
+	{
+		m_polyProxies[m_nodes[proxy].poly->GetIndex()] = proxy;
+	}
+}
+
+void CBroadPhaseAABBTree::UpdateProxies()
+{
+	m_movedProxies.clear();
+
+	ReleaseStaleProxies();
+
+	gVars->pWorld->ForEachPolygon([&](CPolygonPtr poly)
+	{
+		poly->UpdateAABB();
+
+		int& proxy = m_polyProxies[poly->GetIndex()];
+		if (proxy == NULL_TREE_NODE)
+		{
+			proxy = CreateProxy(poly);
+		}
+		else if (!m_nodes[proxy].aabb.Contains(poly->aabb))
+		{
+			MoveProxy(proxy);
+		}
+	});
+}
+
+void CBroadPhaseAABBTree::FindNewPairs()
+{
+	for (int proxy : m_movedProxies)
+	{
+		const STreeNode& node = m_nodes[proxy];
+		bool isStatic = (node.poly->density == 0.0f);
+
+		Query(node.aabb, [&](int otherProxy)
+		{
+			const STreeNode& otherNode = m_nodes[otherProxy];
+
+			// moved pairs are found from both sides, keep one
+			if (otherProxy == proxy || (otherNode.moved && otherProxy < proxy))
+			{
+				return;
+			}
+
+			if (isStatic && otherNode.poly->density == 0.0f)
+			{
+				return;
+			}
+
+			if (m_pairKeys.insert(GetPairKey(proxy, otherProxy)).second)
+			{
+				SProxyPair pair;
+				pair.proxyA = proxy;
+				pair.proxyB = otherProxy;
+				m_pairs.push_back(pair);
+			}
+		});
+	}
+
+	for (int proxy : m_movedProxies)
+	{
+		m_nodes[proxy].moved = false;
+	}
+}
+
+void CBroadPhaseAABBTree::ValidatePairs(std::vector<SPolygonPair>& pairsToCheck)
+{
+	for (size_t i = 0; i < m_pairs.size();)
+	{
+		const SProxyPair& pair = m_pairs[i];
+		const STreeNode& nodeA = m_nodes[pair.proxyA];
+		const STreeNode& nodeB = m_nodes[pair.proxyB];
+
+		if (!nodeA.aabb.Intersect(nodeB.aabb))
+		{
+			// fat AABBs separated, forget the pair until a leaf moves again
+			m_pairKeys.erase(GetPairKey(pair.proxyA, pair.proxyB));
+			m_pairs[i] = m_pairs.back();
+			m_pairs.pop_back();
+			continue;
+		}
+
+		if (nodeA.poly->aabb.Intersect(nodeB.poly->aabb))
+		{
+			pairsToCheck.push_back(SPolygonPair(nodeA.poly, nodeB.poly));
+		}
+
+		++i;
+	}
+}
+
+AABB CBroadPhaseAABBTree::ComputeFatAABB(const CPolygon& poly) const
+{
+	AABB fatAABB = poly.aabb;
+	fatAABB.min -= Vec2(fatMargin, fatMargin);
+	fatAABB.max += Vec2(fatMargin, fatMargin);
+
+	// extend toward the motion so that the leaf stays valid for a few frames
+	Vec2 displacement = poly.speed * velocityPrediction;
+	fatAABB.min += minv(displacement, Vec2());
+	fatAABB.max += maxv(displacement, Vec2());
+
+	return fatAABB;
+}
+
+int CBroadPhaseAABBTree::CreateProxy(CPolygonPtr poly)
+{
+	int proxy = AllocateNode();
+	STreeNode& node = m_nodes[proxy];
+	node.poly = poly;
+	node.aabb = ComputeFatAABB(*poly);
+	node.height = 0;
+	node.moved = true;
+
+	InsertLeaf(proxy);
+	m_movedProxies.push_back(proxy);
+
+	return proxy;
+}
+
+void CBroadPhaseAABBTree::MoveProxy(int proxy)
+{
+	RemoveLeaf(proxy);
+
+	STreeNode& node = m_nodes[proxy];
+	node.aabb = ComputeFatAABB(*node.poly);
+	node.moved = true;
+
+	InsertLeaf(proxy);
+	m_movedProxies.push_back(proxy);
+}
+
+// The pairs of the proxy go first, its node may come back as an internal node
+void CBroadPhaseAABBTree::DestroyProxy(int proxy)
+{
+	for (size_t i = 0; i < m_pairs.size();)
+	{
+		const SProxyPair& pair = m_pairs[i];
+		if (pair.proxyA == proxy || pair.proxyB == proxy)
+		{
+			m_pairKeys.erase(GetPairKey(pair.proxyA, pair.proxyB));
+			m_pairs[i] = m_pairs.back();
+			m_pairs.pop_back();
+			continue;
+		}
+
+		++i;
+	}
+
+	RemoveLeaf(proxy);
+	FreeNode(proxy);
+}
+
+int CBroadPhaseAABBTree::AllocateNode()
+{
+	int nodeId;
+	if (m_freeList != NULL_TREE_NODE)
+	{
+		nodeId = m_freeList;
+		m_freeList = m_nodes[nodeId].parent;
+	}
+	else
+	{
+		nodeId = (int)m_nodes.size();
+		m_nodes.push_back(STreeNode());
+	}
+
+	STreeNode& node = m_nodes[nodeId];
+	node.parent = NULL_TREE_NODE;
+	node.child1 = NULL_TREE_NODE;
+	node.child2 = NULL_TREE_NODE;
+	node.height = 0;
+	node.moved = false;
+
+	return nodeId;
+}
+
+void CBroadPhaseAABBTree::FreeNode(int nodeId)
+{
+	STreeNode& node = m_nodes[nodeId];
+	node.poly.reset();
+	node.height = -1;
+	node.parent = m_freeList;
+	m_freeList = nodeId;
+}
+
+void CBroadPhaseAABBTree::InsertLeaf(int leaf)
+{
+	if (m_root == NULL_TREE_NODE)
+	{
+		m_root = leaf;
+		m_nodes[leaf].parent = NULL_TREE_NODE;
+		return;
+	}
+
+	// find the best sibling, surface area heuristic (perimeter in 2D)
+	AABB leafAABB = m_nodes[leaf].aabb;
+	int index = m_root;
+	while (!m_nodes[index].IsLeaf())
+	{
+		const STreeNode& node = m_nodes[index];
+		int child1 = node.child1;
+		int child2 = node.child2;
+
+		float area = node.aabb.GetPerimeter();
+		float combinedArea = node.aabb.Merge(leafAABB).GetPerimeter();
+
+		// cost of creating a new parent for this node and the new leaf
+		float cost = 2.0f * combinedArea;
+
+		// minimum cost of pushing the leaf further down the tree
+		float inheritanceCost = 2.0f * (combinedArea - area);
+
+		float cost1 = leafAABB.Merge(m_nodes[child1].aabb).GetPerimeter() + inheritanceCost;
+		if (!m_nodes[child1].IsLeaf())
+		{
+			cost1 -= m_nodes[child1].aabb.GetPerimeter();
+		}
+
+		float cost2 = leafAABB.Merge(m_nodes[child2].aabb).GetPerimeter() + inheritanceCost;
+		if (!m_nodes[child2].IsLeaf())
+		{
+			cost2 -= m_nodes[child2].aabb.GetPerimeter();
+		}
+
+		if (cost < cost1 && cost < cost2)
+		{
+			break;
+		}
+
+		index = (cost1 < cost2) ? child1 : child2;
+	}
+
+	int sibling = index;
+
+	// create a new parent
+	int oldParent = m_nodes[sibling].parent;
+	int newParent = AllocateNode();
+	m_nodes[newParent].parent = oldParent;
+	m_nodes[newParent].aabb = leafAABB.Merge(m_nodes[sibling].aabb);
+	m_nodes[newParent].height = m_nodes[sibling].height + 1;
+	m_nodes[newParent].child1 = sibling;
+	m_nodes[newParent].child2 = leaf;
+	m_nodes[sibling].parent = newParent;
+	m_nodes[leaf].parent = newParent;
+
+	if (oldParent != NULL_TREE_NODE)
+	{
+		if (m_nodes[oldParent].child1 == sibling)
+		{
+			m_nodes[oldParent].child1 = newParent;
+		}
+		else
+		{
+			m_nodes[oldParent].child2 = newParent;
+		}
+	}
+	else
+	{
+		m_root = newParent;
+	}
+
+	Refit(m_nodes[leaf].parent);
+}
+
+void CBroadPhaseAABBTree::RemoveLeaf(int leaf)
+{
+	if (leaf == m_root)
+	{
+		m_root = NULL_TREE_NODE;
+		return;
+	}
+
+	int parent = m_nodes[leaf].parent;
+	int grandParent = m_nodes[parent].parent;
+	int sibling = (m_nodes[parent].child1 == leaf) ? m_nodes[parent].child2 : m_nodes[parent].child1;
+
+	if (grandParent != NULL_TREE_NODE)
+	{
+		// destroy parent and connect sibling to grand parent
+		if (m_nodes[grandParent].child1 == parent)
+		{
+			m_nodes[grandParent].child1 = sibling;
+		}
+		else
+		{
+			m_nodes[grandParent].child2 = sibling;
+		}
+		m_nodes[sibling].parent = grandParent;
+		FreeNode(parent);
+
+		Refit(grandParent);
+	}
+	else
+	{
+		m_root = sibling;
+		m_nodes[sibling].parent = NULL_TREE_NODE;
+		FreeNode(parent);
+	}
+}
+
+// walk back up the tree fixing heights and AABBs, balancing on the way
+void CBroadPhaseAABBTree::Refit(int index)
+{
+	while (index != NULL_TREE_NODE)
+	{
+		index = Balance(index);
+
+		STreeNode& node = m_nodes[index];
+		const STreeNode& child1 = m_nodes[node.child1];
+		const STreeNode& child2 = m_nodes[node.child2];
+
+		node.height = 1 + Max(child1.height, child2.height);
+		node.aabb = child1.aabb.Merge(child2.aabb);
+
+		index = node.parent;
+	}
+}
+
+// Perform a left or right rotation if node A is imbalanced, returns the new root index
+int CBroadPhaseAABBTree::Balance(int iA)
+{
+	STreeNode* A = &m_nodes[iA];
+	if (A->IsLeaf() || A->height < 2)
+	{
+		return iA;
+	}
+
+	int iB = A->child1;
+	int iC = A->child2;
+	STreeNode* B = &m_nodes[iB];
+	STreeNode* C = &m_nodes[iC];
+
+	int balance = C->height - B->height;
+
+	// rotate C up
+	if (balance > 1)
+	{
+		int iF = C->child1;
+		int iG = C->child2;
+		STreeNode* F = &m_nodes[iF];
+		STreeNode* G = &m_nodes[iG];
+
+		// swap A and C
+		C->child1 = iA;
+		C->parent = A->parent;
+		A->parent = iC;
+
+		if (C->parent != NULL_TREE_NODE)
+		{
+			if (m_nodes[C->parent].child1 == iA)
+			{
+				m_nodes[C->parent].child1 = iC;
+			}
+			else
+			{
+				m_nodes[C->parent].child2 = iC;
+			}
+		}
+		else
+		{
+			m_root = iC;
+		}
+
+		// rotate
+		if (F->height > G->height)
+		{
+			C->child2 = iF;
+			A->child2 = iG;
+			G->parent = iA;
+			A->aabb = B->aabb.Merge(G->aabb);
+			C->aabb = A->aabb.Merge(F->aabb);
+
+			A->height = 1 + Max(B->height, G->height);
+			C->height = 1 + Max(A->height, F->height);
+		}
+		else
+		{
+			C->child2 = iG;
+			A->child2 = iF;
+			F->parent = iA;
+			A->aabb = B->aabb.Merge(F->aabb);
+			C->aabb = A->aabb.Merge(G->aabb);
+
+			A->height = 1 + Max(B->height, F->height);
+			C->height = 1 + Max(A->height, G->height);
+		}
+
+		return iC;
+	}
+
+	// rotate B up
+	if (balance < -1)
+	{
+		int iD = B->child1;
+		int iE = B->child2;
+		STreeNode* D = &m_nodes[iD];
+		STreeNode* E = &m_nodes[iE];
+
+		// swap A and B
+		B->child1 = iA;
+		B->parent = A->parent;
+		A->parent = iB;
+
+		if (B->parent != NULL_TREE_NODE)
+		{
+			if (m_nodes[B->parent].child1 == iA)
+			{
+				m_nodes[B->parent].child1 = iB;
+			}
+			else
+			{
+				m_nodes[B->parent].child2 = iB;
+			}
+		}
+		else
+		{
+			m_root = iB;
+		}
+
+		// rotate
+		if (D->height > E->height)
+		{
+			B->child2 = iD;
+			A->child1 = iE;
+			E->parent = iA;
+			A->aabb = C->aabb.Merge(E->aabb);
+			B->aabb = A->aabb.Merge(D->aabb);
+
+			A->height = 1 + Max(C->height, E->height);
+			B->height = 1 + Max(A->height, D->height);
+		}
+		else
+		{
+			B->child2 = iE;
+			A->child1 = iD;
+			D->parent = iA;
+			A->aabb = C->aabb.Merge(D->aabb);
+			B->aabb = A->aabb.Merge(E->aabb);
+
+			A->height = 1 + Max(C->height, D->height);
+			B->height = 1 + Max(A->height, E->height);
+		}
+
+		return iB;
+	}
+
+	return iA;
+}
+
+unsigned long long CBroadPhaseAABBTree::GetPairKey(int proxyA, int proxyB)
+{
+	unsigned long long minProxy = (unsigned long long)Min(proxyA, proxyB);
+	unsigned long long maxProxy = (unsigned long long)Max(proxyA, proxyB);
+	return (minProxy << 32) | maxProxy;
+}
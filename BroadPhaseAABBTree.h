@@ -0,0 +1,109 @@
+#ifndef _BROAD_PHASE_AABB_TREE_H_
+#define _BROAD_PHASE_AABB_TREE_H_
+
+#include <unordered_set>
+
+#include "BroadPhase.h"
+
+#define NULL_TREE_NODE (-1)
+
+// Dynamic bounding volume tree, leaves hold fat AABBs (margin + velocity prediction)
+// and are only reinserted when their polygon leaves its fat AABB.
+// Overlapping pairs are kept across frames, only moved leaves look for new pairs.
+class CBroadPhaseAABBTree : public IBroadPhase
+{
+public:
+	virtual void GetCollidingPairsToCheck(std::vector<SPolygonPair>& pairsToCheck) override;
+
+	// params
+	float	fatMargin = 0.1f;
+	float	velocityPrediction = 1.0f / 15.0f; // seconds of motion included in fat AABBs
+
+private:
+	struct STreeNode
+	{
+		bool	IsLeaf() const { return child1 == NULL_TREE_NODE; }
+
+		AABB		aabb;
+		int			parent; // next free node when in free list
+		int			child1;
+		int			child2;
+		int			height; // leaf = 0, free = -1
+
+		// leaves only
+		CPolygonPtr	poly;
+		bool		moved;
+	};
+
+	struct SProxyPair
+	{
+		int	proxyA, proxyB;
+	};
+
+	void	ReleaseStaleProxies();
+	void	UpdateProxies();
+	void	FindNewPairs();
+	void	ValidatePairs(std::vector<SPolygonPair>& pairsToCheck);
+
+	AABB	ComputeFatAABB(const CPolygon& poly) const;
+
+	int		CreateProxy(CPolygonPtr poly);
+	void	MoveProxy(int proxy);
+	void	DestroyProxy(int proxy);
+
+	int		AllocateNode();
+	void	FreeNode(int node);
+
+	void	InsertLeaf(int leaf);
+	void	RemoveLeaf(int leaf);
+	int		Balance(int node);
+	void	Refit(int node);
+
+	template<typename TFunctor>
+	void	Query(const AABB& aabb, TFunctor functor)
+	{
+		m_queryStack.clear();
+		m_queryStack.push_back(m_root);
+
+		while (!m_queryStack.empty())
+		{
+			int nodeId = m_queryStack.back();
+			m_queryStack.pop_back();
+
+			if (nodeId == NULL_TREE_NODE)
+			{
+				continue;
+			}
+
+			const STreeNode& node = m_nodes[nodeId];
+			if (node.aabb.Intersect(aabb))
+			{
+				if (node.IsLeaf())
+				{
+					functor(nodeId);
+				}
+				else
+				{
+					m_queryStack.push_back(node.child1);
+					m_queryStack.push_back(node.child2);
+				}
+			}
+		}
+	}
+
+	static unsigned long long	GetPairKey(int proxyA, int proxyB);
+
+	std::vector<STreeNode>		m_nodes;
+	int							m_root = NULL_TREE_NODE;
+	int							m_freeList = NULL_TREE_NODE;
+
+	std::vector<int>			m_polyProxies; // proxy per polygon index
+	std::vector<int>			m_movedProxies;
+	std::vector<int>			m_queryStack;
+	std::vector<int>			m_relocatedProxies;
+
+	std::vector<SProxyPair>				m_pairs;
+	std::unordered_set<unsigned long long>	m_pairKeys;
+};
+
+#endif
\ No newline at end of file
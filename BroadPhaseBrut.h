@@ -12,20 +12,39 @@ class CBroadPhaseBrut : public IBroadPhase
 public:
 	virtual void GetCollidingPairsToCheck(std::vector<SPolygonPair>& pairsToCheck) override
 	{
-		for (size_t i = 0; i < gVars->pWorld->GetPolygonCount(); ++i)
+		m_dynamicPolys.clear();
+		m_otherPolys.clear();
+
+		gVars->pWorld->ForEachPolygon([&](CPolygonPtr poly)
+		{
+			if (poly->GetBodyType() == EBodyType::Dynamic)
+			{
+				m_dynamicPolys.push_back(poly);
+			}
+			else
+			{
+				m_otherPolys.push_back(poly);
+			}
+		});
+
+		// static and kinematic bodies never pair together
+		for (size_t i = 0; i < m_dynamicPolys.size(); ++i)
 		{
-			for (size_t j = i + 1; j < gVars->pWorld->GetPolygonCount(); ++j)
+			for (size_t j = i + 1; j < m_dynamicPolys.size(); ++j)
 			{
-				CPolygonPtr pA = gVars->pWorld->GetPolygon(i);
-				CPolygonPtr pB = gVars->pWorld->GetPolygon(j);
-				
-				if (pA->density == 0.0f && pB->density == 0.0f)
-					continue;
+				pairsToCheck.push_back(SPolygonPair(m_dynamicPolys[i], m_dynamicPolys[j]));
+			}
 
-				pairsToCheck.push_back(SPolygonPair(gVars->pWorld->GetPolygon(i), gVars->pWorld->GetPolygon(j)));
+			for (const CPolygonPtr& otherPoly : m_otherPolys)
+			{
+				pairsToCheck.push_back(SPolygonPair(m_dynamicPolys[i], otherPoly));
 			}
 		}
 	}
+
+private:
+	std::vector<CPolygonPtr>	m_dynamicPolys;
+	std::vector<CPolygonPtr>	m_otherPolys;
 };
 
 #endif
\ No newline at end of file
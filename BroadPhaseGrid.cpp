@@ -0,0 +1,184 @@
+#include "BroadPhaseGrid.h"
+
+#include <algorithm>
+
+#include "Polygon.h"
+#include "GlobalVariables.h"
+#include "World.h"
+
+static float GetExtent(const AABB& aabb)
+{
+	return Max(aabb.max.x - aabb.min.x, aabb.max.y - aabb.min.y);
+}
+
+void CBroadPhaseGrid::GetCollidingPairsToCheck(std::vector<SPolygonPair>& pairsToCheck)
+{
+	m_bodies.clear();
+	m_overflowBodies.clear();
+	m_extents.clear();
+
+	gVars->pWorld->ForEachPolygon([&](CPolygonPtr poly)
+	{
+		poly->UpdateAABB();
+		m_bodies.push_back(poly);
+		m_extents.push_back(GetExtent(poly->aabb));
+	});
+
+	if (m_bodies.empty())
+	{
+		return;
+	}
+
+	UpdateCellSize();
+
+	float maxExtent = overflowCells * m_cellSize;
+	auto overflowBegin = std::partition(m_bodies.begin(), m_bodies.end(), [&](const CPolygonPtr& poly)
+	{
+		return GetExtent(poly->aabb) <= maxExtent;
+	});
+	m_overflowBodies.assign(overflowBegin, m_bodies.end());
+	m_bodies.erase(overflowBegin, m_bodies.end());
+
+	FillBuckets();
+	FindGridPairs(pairsToCheck);
+	FindOverflowPairs(pairsToCheck);
+}
+
+void CBroadPhaseGrid::UpdateCellSize()
+{
+	auto median = m_extents.begin() + m_extents.size() / 2;
+	std::nth_element(m_extents.begin(), median, m_extents.end());
+
+	m_cellSize = Max(*median * cellSizeScale, 0.001f);
+	m_invCellSize = 1.0f / m_cellSize;
+}
+
+// counting sort of the (cell, body) entries by bucket
+void CBroadPhaseGrid::FillBuckets()
+{
+	size_t entryCount = 0;
+	for (const CPolygonPtr& poly : m_bodies)
+	{
+		const AABB& aabb = poly->aabb;
+		entryCount += (size_t)(GetCell(aabb.max.x) - GetCell(aabb.min.x) + 1) * (size_t)(GetCell(aabb.max.y) - GetCell(aabb.min.y) + 1);
+	}
+
+	// about two buckets per entry to keep hash collisions rare
+	unsigned int bucketCount = 1;
+	while (bucketCount < entryCount * 2)
+	{
+		bucketCount <<= 1;
+	}
+	m_bucketMask = bucketCount - 1;
+
+	m_bucketStarts.assign(bucketCount + 1, 0);
+	m_entries.resize(entryCount);
+
+	for (const CPolygonPtr& poly : m_bodies)
+	{
+		const AABB& aabb = poly->aabb;
+		for (int cellY = GetCell(aabb.min.y); cellY <= GetCell(aabb.max.y); ++cellY)
+		{
+			for (int cellX = GetCell(aabb.min.x); cellX <= GetCell(aabb.max.x); ++cellX)
+			{
+				++m_bucketStarts[GetBucket(cellX, cellY)];
+			}
+		}
+	}
+
+	// bucket ends, turned into bucket starts while filling
+	unsigned int sum = 0;
+	for (unsigned int bucket = 0; bucket < bucketCount; ++bucket)
+	{
+		sum += m_bucketStarts[bucket];
+		m_bucketStarts[bucket] = sum;
+	}
+	m_bucketStarts[bucketCount] = sum;
+
+	for (unsigned int body = 0; body < (unsigned int)m_bodies.size(); ++body)
+	{
+		const AABB& aabb = m_bodies[body]->aabb;
+		for (int cellY = GetCell(aabb.min.y); cellY <= GetCell(aabb.max.y); ++cellY)
+		{
+			for (int cellX = GetCell(aabb.min.x); cellX <= GetCell(aabb.max.x); ++cellX)
+			{
+				SCellEntry& entry = m_entries[--m_bucketStarts[GetBucket(cellX, cellY)]];
+				entry.cellX = cellX;
+				entry.cellY = cellY;
+				entry.body = body;
+			}
+		}
+	}
+}
+
+void CBroadPhaseGrid::FindGridPairs(std::vector<SPolygonPair>& pairsToCheck)
+{
+	for (unsigned int bucket = 0; bucket <= m_bucketMask; ++bucket)
+	{
+		unsigned int end = m_bucketStarts[bucket + 1];
+		for (unsigned int i = m_bucketStarts[bucket]; i < end; ++i)
+		{
+			const SCellEntry& entryA = m_entries[i];
+			const CPolygonPtr& polyA = m_bodies[entryA.body];
+
+			for (unsigned int j = i + 1; j < end; ++j)
+			{
+				const SCellEntry& entryB = m_entries[j];
+				const CPolygonPtr& polyB = m_bodies[entryB.body];
+
+				// other cell hashed in the same bucket
+				if (entryA.cellX != entryB.cellX || entryA.cellY != entryB.cellY)
+				{
+					continue;
+				}
+
+				if ((polyA->density == 0.0f && polyB->density == 0.0f) || !polyA->aabb.Intersect(polyB->aabb))
+				{
+					continue;
+				}
+
+				// pairs sharing several cells are only reported by the cell holding the min corner of their overlap
+				Vec2 overlapMin = maxv(polyA->aabb.min, polyB->aabb.min);
+				if (GetCell(overlapMin.x) == entryA.cellX && GetCell(overlapMin.y) == entryA.cellY)
+				{
+					pairsToCheck.push_back(SPolygonPair(polyA, polyB));
+				}
+			}
+		}
+	}
+}
+
+void CBroadPhaseGrid::FindOverflowPairs(std::vector<SPolygonPair>& pairsToCheck)
+{
+	for (size_t i = 0; i < m_overflowBodies.size(); ++i)
+	{
+		const CPolygonPtr& polyA = m_overflowBodies[i];
+
+		for (const CPolygonPtr& polyB : m_bodies)
+		{
+			if ((polyA->density > 0.0f || polyB->density > 0.0f) && polyA->aabb.Intersect(polyB->aabb))
+			{
+				pairsToCheck.push_back(SPolygonPair(polyA, polyB));
+			}
+		}
+
+		for (size_t j = i + 1; j < m_overflowBodies.size(); ++j)
+		{
+			const CPolygonPtr& polyB = m_overflowBodies[j];
+			if ((polyA->density > 0.0f || polyB->density > 0.0f) && polyA->aabb.Intersect(polyB->aabb))
+			{
+				pairsToCheck.push_back(SPolygonPair(polyA, polyB));
+			}
+		}
+	}
+}
+
+int CBroadPhaseGrid::GetCell(float coord) const
+{
+	return (int)floorf(coord * m_invCellSize);
+}
+
+unsigned int CBroadPhaseGrid::GetBucket(int cellX, int cellY) const
+{
+	return (((unsigned int)cellX * 73856093u) ^ ((unsigned int)cellY * 19349663u)) & m_bucketMask;
+}
@@ -0,0 +1,45 @@
+#ifndef _BROAD_PHASE_GRID_H_
+#define _BROAD_PHASE_GRID_H_
+
+#include "BroadPhase.h"
+
+// Uniform grid hashed into buckets, rebuilt each frame with a counting sort.
+// Cell size follows the median AABB extent, bodies much larger than a cell
+// (scene borders) are kept in an overflow list and tested against everything.
+class CBroadPhaseGrid : public IBroadPhase
+{
+public:
+	virtual void GetCollidingPairsToCheck(std::vector<SPolygonPair>& pairsToCheck) override;
+
+	// params
+	float	cellSizeScale = 1.0f; // cell size = median extent * scale
+	float	overflowCells = 4.0f; // bodies wider than this many cells go to the overflow list
+
+private:
+	struct SCellEntry
+	{
+		int				cellX, cellY;
+		unsigned int	body;
+	};
+
+	void	UpdateCellSize();
+	void	FillBuckets();
+	void	FindGridPairs(std::vector<SPolygonPair>& pairsToCheck);
+	void	FindOverflowPairs(std::vector<SPolygonPair>& pairsToCheck);
+
+	int				GetCell(float coord) const;
+	unsigned int	GetBucket(int cellX, int cellY) const;
+
+	float						m_cellSize = 1.0f;
+	float						m_invCellSize = 1.0f;
+
+	std::vector<CPolygonPtr>	m_bodies;
+	std::vector<CPolygonPtr>	m_overflowBodies;
+	std::vector<float>			m_extents;
+
+	unsigned int				m_bucketMask = 0;
+	std::vector<unsigned int>	m_bucketStarts;
+	std::vector<SCellEntry>		m_entries;
+};
+
+#endif
\ No newline at end of file
@@ -1,24 +1,75 @@
 #include "BroadPhaseSweepAndPrune.h"
 
+#include <algorithm>
+
 #include "Polygon.h"
 #include "GlobalVariables.h"
 #include "World.h"
 
+static bool OverlapOnY(const AABB& aabb1, const AABB& aabb2)
+{
+	return (aabb1.max.y >= aabb2.min.y) && (aabb2.max.y >= aabb1.min.y);
+}
+
 void CBroadPhaseSweepAndPrune::GetCollidingPairsToCheck(std::vector<SPolygonPair>& pairsToCheck)
 {
-	gVars->pWorld->ForEachPolygon([&](CPolygonPtr poly)
+	UpdateBodyLists();
+	SortMovingBodies();
+	SweepMovingBodies(pairsToCheck);
+	SweepMovingAgainstStaticBodies(pairsToCheck);
+}
+
+void CBroadPhaseSweepAndPrune::UpdateBodyLists()
+{
+	bool rebuild = (m_polysXAxis.size() + m_staticPolysXAxis.size() != gVars->pWorld->GetPolygonCount());
+	bool staticMoved = false;
+
+	for (const CPolygonPtr& poly : m_polysXAxis)
 	{
 		poly->UpdateAABB();
-	});
+		rebuild = rebuild || !poly->IsMoving();
+	}
+
+	for (const CPolygonPtr& poly : m_staticPolysXAxis)
+	{
+		// only moved by tools or behaviors, most of the time nothing to do
+		staticMoved = poly->UpdateAABB() || staticMoved;
+		rebuild = rebuild || poly->IsMoving();
+	}
 
-	if (m_polysXAxis.size() == 0)
+	if (rebuild)
 	{
+		m_polysXAxis.clear();
+		m_staticPolysXAxis.clear();
+
 		gVars->pWorld->ForEachPolygon([&](CPolygonPtr poly)
 		{
-			m_polysXAxis.push_back(poly);
+			poly->UpdateAABB();
+			if (poly->IsMoving())
+			{
+				m_polysXAxis.push_back(poly);
+			}
+			else
+			{
+				m_staticPolysXAxis.push_back(poly);
+			}
 		});
+
+		staticMoved = true;
 	}
 
+	if (staticMoved)
+	{
+		std::sort(m_staticPolysXAxis.begin(), m_staticPolysXAxis.end(), [](const CPolygonPtr& polyA, const CPolygonPtr& polyB)
+		{
+			return polyA->aabb.min.x < polyB->aabb.min.x;
+		});
+	}
+}
+
+// insertion sort on min x, the list is almost sorted from the previous frame
+void CBroadPhaseSweepAndPrune::SortMovingBodies()
+{
 	int i = (int)m_polysXAxis.size() - 2;
 	while (i >= 0)
 	{
@@ -32,27 +83,72 @@ void CBroadPhaseSweepAndPrune::GetCollidingPairsToCheck(std::vector<SPolygonPair
 			m_polysXAxis[j] = polyA;
 			++j;
 		}
-		// polyA is located now at j - 1 index, and j verify (polyA->aabb.minx.x <= m_polysXAxis[j]->aabb.min.x)
-		while (j < (int)m_polysXAxis.size() && (polyA->aabb.max.x > m_polysXAxis[j]->aabb.min.x))
-		{
-			// x colliding
-			size_t indexA = polyA->GetIndex();
-			size_t indexB = m_polysXAxis[j]->GetIndex();
-			size_t key = Min(indexA, indexB) * m_polysXAxis.size() + Max(indexA, indexB);
-			//m_collidingPairsOnX[key] = true;
 
-			AABB& aabb1 = polyA->aabb;
-			AABB& aabb2 = m_polysXAxis[j]->aabb;
+		--i;
+	}
+}
+
+// sweep once the whole list is sorted, so that polys inserted on the right of polyA are not missed
+void CBroadPhaseSweepAndPrune::SweepMovingBodies(std::vector<SPolygonPair>& pairsToCheck)
+{
+	for (size_t indexA = 0; indexA < m_polysXAxis.size(); ++indexA)
+	{
+		const CPolygonPtr& polyA = m_polysXAxis[indexA];
 
-			bool sep = (aabb1.max.y < aabb2.min.y) || (aabb2.max.y < aabb1.min.y);
-			if (!sep && (polyA->density > 0.0f || m_polysXAxis[j]->density > 0.0f))
+		size_t j = indexA + 1;
+		while (j < m_polysXAxis.size() && (polyA->aabb.max.x >= m_polysXAxis[j]->aabb.min.x))
+		{
+			// x colliding, kinematic pairs are skipped
+			const CPolygonPtr& polyB = m_polysXAxis[j];
+			if (OverlapOnY(polyA->aabb, polyB->aabb) && (polyA->density > 0.0f || polyB->density > 0.0f))
 			{
-				pairsToCheck.push_back(SPolygonPair(polyA, m_polysXAxis[j]));
+				pairsToCheck.push_back(SPolygonPair(polyA, polyB));
 			}
 
 			++j;
 		}
+	}
+}
 
-		--i;
+// Both lists are walked in min x order, each body looks ahead in the other list only,
+// so static pairs are never visited
+void CBroadPhaseSweepAndPrune::SweepMovingAgainstStaticBodies(std::vector<SPolygonPair>& pairsToCheck)
+{
+	size_t movingIndex = 0;
+	size_t staticIndex = 0;
+
+	while (movingIndex < m_polysXAxis.size() && staticIndex < m_staticPolysXAxis.size())
+	{
+		const CPolygonPtr& movingPoly = m_polysXAxis[movingIndex];
+		const CPolygonPtr& staticPoly = m_staticPolysXAxis[staticIndex];
+
+		if (movingPoly->aabb.min.x <= staticPoly->aabb.min.x)
+		{
+			if (movingPoly->density > 0.0f)
+			{
+				for (size_t j = staticIndex; j < m_staticPolysXAxis.size() && (movingPoly->aabb.max.x >= m_staticPolysXAxis[j]->aabb.min.x); ++j)
+				{
+					if (OverlapOnY(movingPoly->aabb, m_staticPolysXAxis[j]->aabb))
+					{
+						pairsToCheck.push_back(SPolygonPair(movingPoly, m_staticPolysXAxis[j]));
+					}
+				}
+			}
+
+			++movingIndex;
+		}
+		else
+		{
+			for (size_t j = movingIndex; j < m_polysXAxis.size() && (staticPoly->aabb.max.x >= m_polysXAxis[j]->aabb.min.x); ++j)
+			{
+				const CPolygonPtr& otherPoly = m_polysXAxis[j];
+				if (otherPoly->density > 0.0f && OverlapOnY(staticPoly->aabb, otherPoly->aabb))
+				{
+					pairsToCheck.push_back(SPolygonPair(otherPoly, staticPoly));
+				}
+			}
+
+			++staticIndex;
+		}
 	}
 }
\ No newline at end of file
@@ -9,9 +9,14 @@ public:
 	virtual void GetCollidingPairsToCheck(std::vector<SPolygonPair>& pairsToCheck) override;
 
 private:
+	void	UpdateBodyLists();
+	void	SortMovingBodies();
+	void	SweepMovingBodies(std::vector<SPolygonPair>& pairsToCheck);
+	void	SweepMovingAgainstStaticBodies(std::vector<SPolygonPair>& pairsToCheck);
+
 	// Broad phase
-	std::vector<CPolygonPtr>			m_polysXAxis;
-	std::unordered_map<size_t, bool>	m_collidingPairsOnX;
+	std::vector<CPolygonPtr>			m_polysXAxis; // dynamic and kinematic, almost sorted from the previous frame
+	std::vector<CPolygonPtr>			m_staticPolysXAxis; // sorted again only when a static body moved
 };
 
 #endif
\ No newline at end of file
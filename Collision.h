@@ -11,6 +11,34 @@ struct SPolygonPair
 	CPolygonPtr	polyB;
 };
 
+// Identifies a manifold point across frames : the edges of A and B it comes from,
+// the incident edge end it started from and the reference edge side that clipped it
+struct SContactID
+{
+	unsigned short	edgeA = 0;
+	unsigned short	edgeB = 0;
+	unsigned char	incidentVertex = 0;
+	unsigned char	clipSide = 0; // 0 : not clipped, 1 : by the reference edge start, 2 : by its end
+	bool			referenceOnA = true;
+
+	// every field keeps all its bits, distinct IDs never share a key
+	unsigned long long	GetKey() const
+	{
+		return ((unsigned long long)edgeA << 32) | ((unsigned long long)edgeB << 16) | ((unsigned long long)incidentVertex << 8)
+			| ((unsigned long long)clipSide << 1) | (referenceOnA ? 1ull : 0ull);
+	}
+
+	// same point seen from the (B, A) pair
+	SContactID		GetSwapped() const
+	{
+		SContactID id = *this;
+		id.edgeA = edgeB;
+		id.edgeB = edgeA;
+		id.referenceOnA = !referenceOnA;
+		return id;
+	}
+};
+
 struct SContactInfo
 {
 	SContactInfo() = default;
@@ -38,7 +66,8 @@ struct SContactInfo
 	Vec2	edgeNormalA;
 	Vec2	edgeNormalB;
 
-	size_t	index;
+	size_t		index;
+	SContactID	id;
 };
 
 struct SContact
@@ -61,6 +90,21 @@ struct SContact
 
 
 	float	normalVelocityBias;
+
+	// Jacobian terms and inverse effective masses, set once by InitVelocityConstraint
+	Vec2	tangent;
+	float	rACrossN;
+	float	rBCrossN;
+	float	rACrossT;
+	float	rBCrossT;
+	float	normalMass;
+	float	tangentMass;
+
+	// contact point in both body frames, the position solve tracks the separation with them
+	Vec2	localAnchorA;
+	Vec2	localAnchorB;
+
+	SContactID	id;
 };
 
 
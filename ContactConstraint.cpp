@@ -2,45 +2,85 @@
 
 #include "Renderer.h"
 #include "GlobalVariables.h"
+#include "PairCache.h"
 
-CContactConstraint::CContactConstraint(SCollision& collision, float rotationCoeff)
+CContactConstraint::CContactConstraint(SCollision& collision, const std::vector<SSolverBody>& bodies, unsigned int bodyA, unsigned int bodyB)
 	: m_pA(collision.polyA)
 	, m_pB(collision.polyB)
+	, m_bodyA(bodyA)
+	, m_bodyB(bodyB)
+	, m_invMassA(bodies[bodyA].invMass)
+	, m_invMassB(bodies[bodyB].invMass)
+	, m_invTensorA(bodies[bodyA].invTensor)
+	, m_invTensorB(bodies[bodyB].invTensor)
 	, m_manifoldSize(collision.manifoldSize)
 	, m_redundant(false)
+	, m_fixedNormal(false)
 {
-	m_invMassA = (m_pA->density > 0.0f) ? 1.0f / m_pA->GetMass() : 0.0f;
-	m_invMassB = (m_pB->density > 0.0f) ? 1.0f / m_pB->GetMass() : 0.0f;
-	m_invTensorA = ((m_pA->density > 0.0f) ? 1.0f / m_pA->GetInertiaTensor() : 0.0f) * rotationCoeff;
-	m_invTensorB = ((m_pB->density > 0.0f) ? 1.0f / m_pB->GetInertiaTensor() : 0.0f) * rotationCoeff;
-
+	Mat2 invRotationA = m_pA->rotation.GetInverseOrtho();
+	Mat2 invRotationB = m_pB->rotation.GetInverseOrtho();
 
 	for (size_t i = 0; i < collision.manifoldSize; ++i)
 	{
 		m_manifold[i] = SContact(collision.manifold[i].point, collision.manifold[i].point - m_pA->position, collision.manifold[i].point - m_pB->position, collision.manifold[i].normal, collision.manifold[i].penetration);
 		m_manifold[i].edgeNormalA = collision.manifold[i].edgeNormalA;
 		m_manifold[i].edgeNormalB = collision.manifold[i].edgeNormalB;
+		m_manifold[i].id = collision.manifold[i].id;
+		m_manifold[i].localAnchorA = invRotationA * m_manifold[i].rA;
+		m_manifold[i].localAnchorB = invRotationB * m_manifold[i].rB;
+	}
+
+	// the normal follows the body owning the reference edge, circles don't carry it along their rotation
+	if (m_manifoldSize > 0)
+	{
+		const CPolygonPtr& reference = m_manifold[0].id.referenceOnA ? m_pA : m_pB;
+		m_fixedNormal = reference->GetShapeType() == EShapeType::Circle;
+		m_localNormal = m_fixedNormal ? m_manifold[0].normal : (m_manifold[0].id.referenceOnA ? invRotationA : invRotationB) * m_manifold[0].normal;
 	}
 }
 
-void CContactConstraint::InitVelocityConstraint(float deltaTime, float restVelocityThreshold, float restitution)
+void CContactConstraint::InitVelocityConstraint(const std::vector<SSolverBody>& bodies, float deltaTime, float restVelocityThreshold, float restitution)
 {
+	const SSolverBody& bodyA = bodies[m_bodyA];
+	const SSolverBody& bodyB = bodies[m_bodyB];
+	float invMassSum = m_invMassA + m_invMassB;
+
 	for (size_t i = 0; i < m_manifoldSize; ++i)
 	{
-		float vn = (m_pB->GetPointVelocity(m_manifold[i].point) - m_pA->GetPointVelocity(m_manifold[i].point)) | m_manifold[i].normal;
-		m_manifold[i].normalVelocityBias = Select(vn < -restVelocityThreshold, -vn * restitution, 0.0f);
+		SContact& contact = m_manifold[i];
+
+		Vec2 pointVelocityA = bodyA.speed + contact.rA.GetNormal() * bodyA.angularVelocity;
+		Vec2 pointVelocityB = bodyB.speed + contact.rB.GetNormal() * bodyB.angularVelocity;
+		float vn = (pointVelocityB - pointVelocityA) | contact.normal;
+		contact.normalVelocityBias = Select(vn < -restVelocityThreshold, -vn * restitution, 0.0f);
+		if (contact.penetration < 0.0f)
+		{
+			// speculative, the bodies may still close the gap during the step
+			contact.normalVelocityBias = contact.penetration / deltaTime;
+		}
+
+		contact.tangent = contact.normal.GetNormal();
+		contact.rACrossN = contact.rA ^ contact.normal;
+		contact.rBCrossN = contact.rB ^ contact.normal;
+		contact.rACrossT = contact.rA ^ contact.tangent;
+		contact.rBCrossT = contact.rB ^ contact.tangent;
+
+		float normalEffectiveMass = invMassSum + contact.rACrossN * contact.rACrossN * m_invTensorA + contact.rBCrossN * contact.rBCrossN * m_invTensorB;
+		float tangentEffectiveMass = invMassSum + contact.rACrossT * contact.rACrossT * m_invTensorA + contact.rBCrossT * contact.rBCrossT * m_invTensorB;
+		contact.normalMass = (normalEffectiveMass > 0.0f) ? 1.0f / normalEffectiveMass : 0.0f;
+		contact.tangentMass = (tangentEffectiveMass > 0.0f) ? 1.0f / tangentEffectiveMass : 0.0f;
 	}
 
 	if (m_manifoldSize == 2)
 	{
-		float rA1CrossN = m_manifold[0].rA ^ m_manifold[0].normal;
-		float rB1CrossN = m_manifold[0].rB ^ m_manifold[0].normal;
-		float rA2CrossN = m_manifold[1].rA ^ m_manifold[1].normal;
-		float rB2CrossN = m_manifold[1].rB ^ m_manifold[1].normal;
+		float rA1CrossN = m_manifold[0].rACrossN;
+		float rB1CrossN = m_manifold[0].rBCrossN;
+		float rA2CrossN = m_manifold[1].rACrossN;
+		float rB2CrossN = m_manifold[1].rBCrossN;
 
-		float a11 = m_invMassA + m_invMassB + rA1CrossN * rA1CrossN * m_invTensorA + rB1CrossN * rB1CrossN * m_invTensorB;
-		float a22 = m_invMassA + m_invMassB + rA2CrossN * rA2CrossN * m_invTensorA + rB2CrossN * rB2CrossN * m_invTensorB;
-		float a12 = m_invMassA + m_invMassB + rA1CrossN * rA2CrossN * m_invTensorA + rB1CrossN * rB2CrossN * m_invTensorB;
+		float a11 = invMassSum + rA1CrossN * rA1CrossN * m_invTensorA + rB1CrossN * rB1CrossN * m_invTensorB;
+		float a22 = invMassSum + rA2CrossN * rA2CrossN * m_invTensorA + rB2CrossN * rB2CrossN * m_invTensorB;
+		float a12 = invMassSum + rA1CrossN * rA2CrossN * m_invTensorA + rB1CrossN * rB2CrossN * m_invTensorB;
 
 		m_JWJT.X = Vec2(a11, a12);
 		m_JWJT.Y = Vec2(a12, a22);
@@ -56,14 +96,85 @@ void CContactConstraint::InitVelocityConstraint(float deltaTime, float restVeloc
 	}
 }
 
-void CContactConstraint::SolveVelocityConstraint(float staticFriction)
+// Manifold points are matched by feature, their ID keys are taken in the record pair order
+static unsigned long long GetRecordIDKey(const SContact& contact, const CPolygon* polyA, const SPairRecord& record)
+{
+	return (record.polyA.get() == polyA) ? contact.id.GetKey() : contact.id.GetSwapped().GetKey();
+}
+
+void CContactConstraint::LoadImpulses(const SPairRecord& record)
+{
+	for (size_t i = 0; i < m_manifoldSize; ++i)
+	{
+		SContact& contact = m_manifold[i];
+		unsigned long long idKey = GetRecordIDKey(contact, m_pA.get(), record);
+
+		for (size_t j = 0; j < record.contactCount; ++j)
+		{
+			if (record.contacts[j].idKey == idKey)
+			{
+				// the normal and tangent flip with the pair order, impulses don't
+				contact.normalImpulse = record.contacts[j].normalImpulse;
+				contact.tangentImpulse = record.contacts[j].tangentImpulse;
+				break;
+			}
+		}
+	}
+}
+
+void CContactConstraint::ApplyImpulses(std::vector<SSolverBody>& bodies) const
+{
+	Vec2	linearImpulse;
+	float	angularImpulseA = 0.0f;
+	float	angularImpulseB = 0.0f;
+
+	for (size_t i = 0; i < m_manifoldSize; ++i)
+	{
+		const SContact& contact = m_manifold[i];
+		Vec2 impulse = contact.normal * contact.normalImpulse + contact.tangent * contact.tangentImpulse;
+
+		linearImpulse += impulse;
+		angularImpulseA += contact.rA ^ impulse;
+		angularImpulseB += contact.rB ^ impulse;
+	}
+
+	if (m_invMassA > 0.0f)
+	{
+		bodies[m_bodyA].speed -= linearImpulse * m_invMassA;
+		bodies[m_bodyA].angularVelocity -= angularImpulseA * m_invTensorA;
+	}
+	if (m_invMassB > 0.0f)
+	{
+		bodies[m_bodyB].speed += linearImpulse * m_invMassB;
+		bodies[m_bodyB].angularVelocity += angularImpulseB * m_invTensorB;
+	}
+}
+
+void CContactConstraint::CacheImpulses(SPairRecord& record) const
 {
-	Vec2&	vA = m_pA->speed;
-	Vec2&	vB = m_pB->speed;
-	float&	wA = m_pA->angularVelocity;
-	float&	wB = m_pB->angularVelocity;
+	record.contactCount = m_manifoldSize;
+	for (size_t i = 0; i < m_manifoldSize; ++i)
+	{
+		const SContact& contact = m_manifold[i];
+		record.contacts[i].idKey = GetRecordIDKey(contact, m_pA.get(), record);
+		record.contacts[i].normalImpulse = contact.normalImpulse;
+		record.contacts[i].tangentImpulse = contact.tangentImpulse;
+	}
+}
+
+float CContactConstraint::SolveVelocityConstraint(std::vector<SSolverBody>& bodies, float staticFriction)
+{
+	SSolverBody& bodyA = bodies[m_bodyA];
+	SSolverBody& bodyB = bodies[m_bodyB];
+
+	// static and kinematic bodies are only read, islands sharing them can be solved concurrently
+	Vec2	vA = bodyA.speed;
+	Vec2	vB = bodyB.speed;
+	float	wA = bodyA.angularVelocity;
+	float	wB = bodyB.angularVelocity;
 
 	bool patchSolveSucceed = false;
+	float maxLambda = 0.0f;
 
 	// solve friction first
 	for (size_t i = 0; i < m_manifoldSize; ++i)
@@ -71,17 +182,17 @@ void CContactConstraint::SolveVelocityConstraint(float staticFriction)
 		float& normalImpulse = m_manifold[i].normalImpulse;
 		float& tangentImpulse = m_manifold[i].tangentImpulse;
 
-		Vec2 t = m_manifold[i].normal.GetNormal();;
-		float rACrossT = m_manifold[i].rA ^ t;
-		float rBCrossT = m_manifold[i].rB ^ t;
+		const Vec2& t = m_manifold[i].tangent;
+		float rACrossT = m_manifold[i].rACrossT;
+		float rBCrossT = m_manifold[i].rBCrossT;
 
 		float JV = -(t | vA) - rACrossT * wA + (t | vB) + rBCrossT * wB;
-		float effectiveMass = m_invMassA + m_invMassB + rACrossT * rACrossT * m_invTensorA + rBCrossT * rBCrossT * m_invTensorB;
 
-		float lambda = -JV / effectiveMass;
+		float lambda = -JV * m_manifold[i].tangentMass;
 
 		lambda = Clamp(lambda, -staticFriction* normalImpulse - tangentImpulse, staticFriction * normalImpulse - tangentImpulse);
 		m_manifold[i].tangentImpulse += lambda;
+		maxLambda = Max(maxLambda, fabsf(lambda));
 
 		vA -= t * m_invMassA * lambda;
 		wA -= rACrossT * m_invTensorA * lambda;
@@ -99,10 +210,10 @@ void CContactConstraint::SolveVelocityConstraint(float staticFriction)
 		// Solve A*x + b >= 0 with transpose(x)*(A*x + b) = 0 (LCP) (either impulse (xi) = 0, either speed (A*x + b)i = 0, impulse separate only if needed)
 
 		const Vec2& n = m_manifold[0].normal;
-		float rA1CrossN = m_manifold[0].rA ^ n;
-		float rB1CrossN = m_manifold[0].rB ^ n;
-		float rA2CrossN = m_manifold[1].rA ^ n;
-		float rB2CrossN = m_manifold[1].rB ^ n;
+		float rA1CrossN = m_manifold[0].rACrossN;
+		float rB1CrossN = m_manifold[0].rBCrossN;
+		float rA2CrossN = m_manifold[1].rACrossN;
+		float rB2CrossN = m_manifold[1].rBCrossN;
 
 		Vec2 bias(m_manifold[0].normalVelocityBias, m_manifold[1].normalVelocityBias);
 		Vec2 a(m_manifold[0].normalImpulse, m_manifold[1].normalImpulse);
@@ -121,6 +232,7 @@ void CContactConstraint::SolveVelocityConstraint(float staticFriction)
 
 			normalImpulse1 = accumulatedImpulses.x;
 			normalImpulse2 = accumulatedImpulses.y;
+			maxLambda = Max(maxLambda, Max(fabsf(lambda1), fabsf(lambda2)));
 
 			vA -= n * m_invMassA * (lambda1 + lambda2);
 			wA -= (rA1CrossN * lambda1 + rA2CrossN * lambda2) * m_invTensorA;
@@ -135,51 +247,221 @@ void CContactConstraint::SolveVelocityConstraint(float staticFriction)
 		float& normalImpulse = m_manifold[i].normalImpulse;
 
 		const Vec2& n = m_manifold[i].normal;
-		float rACrossN = m_manifold[i].rA ^ n;
-		float rBCrossN = m_manifold[i].rB ^ n;
+		float rACrossN = m_manifold[i].rACrossN;
+		float rBCrossN = m_manifold[i].rBCrossN;
 
 		float JV = -(n | vA) - rACrossN * wA + (n | vB) + rBCrossN * wB;
-		float effectiveMass = m_invMassA + m_invMassB + rACrossN * rACrossN * m_invTensorA + rBCrossN * rBCrossN * m_invTensorB;
 
-		float lambda = (m_manifold[i].normalVelocityBias - JV) / effectiveMass;
+		float lambda = (m_manifold[i].normalVelocityBias - JV) * m_manifold[i].normalMass;
 		lambda = Max(-normalImpulse, lambda);
 
 		normalImpulse += lambda;
+		maxLambda = Max(maxLambda, fabsf(lambda));
 
 		vA -= n * m_invMassA * lambda;
 		wA -= rACrossN * m_invTensorA * lambda;
 		vB += n * m_invMassB * lambda;
 		wB += rBCrossN * m_invTensorB * lambda;
 	}
+
+	if (m_invMassA > 0.0f)
+	{
+		bodyA.speed = vA;
+		bodyA.angularVelocity = wA;
+	}
+	if (m_invMassB > 0.0f)
+	{
+		bodyB.speed = vB;
+		bodyB.angularVelocity = wB;
+	}
+
+	return maxLambda * (m_invMassA + m_invMassB);
+}
+
+// The anchors of a contact point start at the same place, the separation is the penetration
+// found by the narrowphase minus how much they moved apart along the normal since then
+float CContactConstraint::GetSeparation(const SContact& contact, Vec2& rA, Vec2& rB, Vec2& n) const
+{
+	rA = m_pA->rotation * contact.localAnchorA;
+	rB = m_pB->rotation * contact.localAnchorB;
+	n = m_fixedNormal ? m_localNormal : (contact.id.referenceOnA ? m_pA->rotation : m_pB->rotation) * m_localNormal;
+
+	return (((m_pB->position + rB) - (m_pA->position + rA)) | n) - contact.penetration;
 }
 
-void CContactConstraint::SolvePositionConstraint(float slop, float dampening, size_t iterations)
+float CContactConstraint::SolvePositionConstraint(float slop, float correctionFactor, float maxCorrection)
 {
-	Vec2&	vA = m_pA->speed;
-	Vec2&	vB = m_pB->speed;
-	float&	wA = m_pA->angularVelocity;
-	float&	wB = m_pB->angularVelocity;
+	float minSeparation = 0.0f;
 
 	for (size_t i = 0; i < m_manifoldSize; ++i)
 	{
-		float dist = Max(m_manifold[i].penetration - slop, 0.0f);
-		if (dist <= 0.0f)
+		Vec2 rA, rB, n;
+		float separation = GetSeparation(m_manifold[i], rA, rB, n);
+		minSeparation = Min(minSeparation, separation);
+
+		// only the penetration beyond slop is corrected, a fraction of it per iteration
+		float C = Clamp(correctionFactor * (separation + slop), -maxCorrection, 0.0f);
+		if (C >= 0.0f)
+		{
 			continue;
+		}
 
-		const Vec2& n = m_manifold[i].normal;
-		float rACrossN = m_manifold[i].rA ^ n;
-		float rBCrossN = m_manifold[i].rB ^ n;
+		float rACrossN = rA ^ n;
+		float rBCrossN = rB ^ n;
+		float effectiveMass = m_invMassA + m_invMassB + rACrossN * rACrossN * m_invTensorA + rBCrossN * rBCrossN * m_invTensorB;
+		float impulse = -C / effectiveMass;
 
-		float factor = 1.0f / (float)m_manifoldSize;
-		dist *= factor * (dampening /(float)iterations);
-		dist /= m_invMassA + m_invMassB + rACrossN * rACrossN * m_invTensorA * 0 + rBCrossN * rBCrossN * m_invTensorB * 0;
+		Vec2 separationImpulse = n * impulse;
 
-		Vec2 separation = m_manifold[i].normal * dist;
+		if (m_invMassA > 0.0f)
+		{
+			m_pA->position -= separationImpulse * m_invMassA;
+			m_pA->rotation.Rotate(RAD2DEG(-rACrossN * m_invTensorA * impulse));
+		}
+		if (m_invMassB > 0.0f)
+		{
+			m_pB->position += separationImpulse * m_invMassB;
+			m_pB->rotation.Rotate(RAD2DEG(rBCrossN * m_invTensorB * impulse));
+		}
+	}
+
+	return minSeparation;
+}
+
+// Soft step of Box2D v3 : the contact behaves as a spring-damper, only its separation is updated
+// between substeps, the Jacobians and masses of the start of the step are kept
+SSoftness MakeSoftness(float hertz, float dampingRatio, float deltaTime)
+{
+	float omega = 2.0f * (float)M_PI * hertz;
+	float a1 = 2.0f * dampingRatio + deltaTime * omega;
+	float a2 = deltaTime * omega * a1;
+	float a3 = 1.0f / (1.0f + a2);
+
+	SSoftness softness;
+	softness.biasRate = omega / a1;
+	softness.massScale = a2 * a3;
+	softness.impulseScale = a3;
+	return softness;
+}
+
+void CContactConstraint::SolveSoftConstraint(std::vector<SSolverBody>& bodies, const SSoftStep& step, bool useBias)
+{
+	SSolverBody& bodyA = bodies[m_bodyA];
+	SSolverBody& bodyB = bodies[m_bodyB];
+
+	Vec2	vA = bodyA.speed;
+	Vec2	vB = bodyB.speed;
+	float	wA = bodyA.angularVelocity;
+	float	wB = bodyB.angularVelocity;
+
+	const SSoftness& softness = (m_invMassA == 0.0f || m_invMassB == 0.0f) ? step.staticSoftness : step.contactSoftness;
+
+	// non-penetration first, friction is bounded by the new normal impulses
+	for (size_t i = 0; i < m_manifoldSize; ++i)
+	{
+		SContact& contact = m_manifold[i];
+
+		Vec2 rA, rB, n;
+		float separation = GetSeparation(contact, rA, rB, n);
+
+		float bias = 0.0f;
+		float massScale = 1.0f;
+		float impulseScale = 0.0f;
+		if (separation > 0.0f)
+		{
+			// speculative, the bodies may close the gap during this substep
+			bias = separation * step.invSubStep;
+		}
+		else if (useBias)
+		{
+			bias = Max(softness.biasRate * Min(separation + step.slop, 0.0f), -step.maxPushVelocity);
+			massScale = softness.massScale;
+			impulseScale = softness.impulseScale;
+		}
+
+		const Vec2& normal = contact.normal;
+		float JV = -(normal | vA) - contact.rACrossN * wA + (normal | vB) + contact.rBCrossN * wB;
+
+		float lambda = -contact.normalMass * massScale * (JV + bias) - impulseScale * contact.normalImpulse;
+		lambda = Max(-contact.normalImpulse, lambda);
+		contact.normalImpulse += lambda;
+
+		vA -= normal * m_invMassA * lambda;
+		wA -= contact.rACrossN * m_invTensorA * lambda;
+		vB += normal * m_invMassB * lambda;
+		wB += contact.rBCrossN * m_invTensorB * lambda;
+	}
+
+	for (size_t i = 0; i < m_manifoldSize; ++i)
+	{
+		SContact& contact = m_manifold[i];
+
+		const Vec2& t = contact.tangent;
+		float JV = -(t | vA) - contact.rACrossT * wA + (t | vB) + contact.rBCrossT * wB;
+
+		float maxFriction = step.staticFriction * contact.normalImpulse;
+		float lambda = Clamp(-JV * contact.tangentMass, -maxFriction - contact.tangentImpulse, maxFriction - contact.tangentImpulse);
+		contact.tangentImpulse += lambda;
+
+		vA -= t * m_invMassA * lambda;
+		wA -= contact.rACrossT * m_invTensorA * lambda;
+		vB += t * m_invMassB * lambda;
+		wB += contact.rBCrossT * m_invTensorB * lambda;
+	}
+
+	if (m_invMassA > 0.0f)
+	{
+		bodyA.speed = vA;
+		bodyA.angularVelocity = wA;
+	}
+	if (m_invMassB > 0.0f)
+	{
+		bodyB.speed = vB;
+		bodyB.angularVelocity = wB;
+	}
+}
+
+// Only points that were approaching fast enough and stayed in contact bounce
+void CContactConstraint::ApplyRestitution(std::vector<SSolverBody>& bodies)
+{
+	SSolverBody& bodyA = bodies[m_bodyA];
+	SSolverBody& bodyB = bodies[m_bodyB];
 
-		m_pA->position -= separation * m_invMassA;
-		m_pA->rotation.Rotate(RAD2DEG(-rACrossN * m_invTensorA * 0 * dist));
-		m_pB->position += separation * m_invMassB;
-		m_pB->rotation.Rotate(RAD2DEG(rBCrossN * m_invTensorB * 0 * dist));
+	Vec2	vA = bodyA.speed;
+	Vec2	vB = bodyB.speed;
+	float	wA = bodyA.angularVelocity;
+	float	wB = bodyB.angularVelocity;
+
+	for (size_t i = 0; i < m_manifoldSize; ++i)
+	{
+		SContact& contact = m_manifold[i];
+		if (contact.normalVelocityBias <= 0.0f || contact.normalImpulse <= 0.0f)
+		{
+			continue;
+		}
+
+		const Vec2& normal = contact.normal;
+		float JV = -(normal | vA) - contact.rACrossN * wA + (normal | vB) + contact.rBCrossN * wB;
+
+		float lambda = (contact.normalVelocityBias - JV) * contact.normalMass;
+		lambda = Max(-contact.normalImpulse, lambda);
+		contact.normalImpulse += lambda;
+
+		vA -= normal * m_invMassA * lambda;
+		wA -= contact.rACrossN * m_invTensorA * lambda;
+		vB += normal * m_invMassB * lambda;
+		wB += contact.rBCrossN * m_invTensorB * lambda;
+	}
+
+	if (m_invMassA > 0.0f)
+	{
+		bodyA.speed = vA;
+		bodyA.angularVelocity = wA;
+	}
+	if (m_invMassB > 0.0f)
+	{
+		bodyB.speed = vB;
+		bodyB.angularVelocity = wB;
 	}
 }
 
@@ -1,24 +1,79 @@
 #ifndef _CONTACT_CONSTRAINT_H_
 #define _CONTACT_CONSTRAINT_H_
 
+#include <vector>
+
 #include "Maths.h"
 
 #include "Collision.h"
 
+struct SPairRecord;
+
+// Velocities and mass properties of a body, gathered in a dense array for the solve.
+// Static and kinematic bodies have no mass and are never written.
+struct alignas(16) SSolverBody
+{
+	Vec2	speed;
+	float	angularVelocity;
+	float	invMass;
+	float	invTensor;	// scaled by the engine rotationCoeff
+};
+
+// Spring-damper coefficients of a soft contact, for a given time step
+struct SSoftness
+{
+	float	biasRate;		// velocity bias per unit of separation
+	float	massScale;
+	float	impulseScale;	// fraction of the accumulated impulse relaxed per solve
+};
+
+SSoftness	MakeSoftness(float hertz, float dampingRatio, float deltaTime);
+
+// Settings shared by every contact during a sub-stepped soft solve
+struct SSoftStep
+{
+	SSoftness	contactSoftness;
+	SSoftness	staticSoftness;	// stiffer, for contacts against static or kinematic bodies
+	float		invSubStep;
+	float		maxPushVelocity; // separation speed limit of penetrating contacts
+	float		slop;
+	float		staticFriction;
+};
+
 struct CContactConstraint
 {
 public:
-	CContactConstraint(SCollision& collision, float rotationCoeff);
+	// bodyA and bodyB are the solver bodies of collision.polyA and collision.polyB
+	CContactConstraint(SCollision& collision, const std::vector<SSolverBody>& bodies, unsigned int bodyA, unsigned int bodyB);
 
-	void		InitVelocityConstraint(float deltaTime, float restVelocityThreshold, float restitution);
-	void		SolveVelocityConstraint(float staticFriction);
+	void		InitVelocityConstraint(const std::vector<SSolverBody>& bodies, float deltaTime, float restVelocityThreshold, float restitution);
 
-	void		SolvePositionConstraint(float slop, float dampening, size_t iterations);
+	// Warm starting, impulses are kept in the pair cache records between steps
+	void		LoadImpulses(const SPairRecord& record);
+	void		ApplyImpulses(std::vector<SSolverBody>& bodies) const;
+	void		CacheImpulses(SPairRecord& record) const;
+	// returns the largest relative velocity change applied at a contact point
+	float		SolveVelocityConstraint(std::vector<SSolverBody>& bodies, float staticFriction);
+
+	// Nonlinear Gauss-Seidel, separations are re-evaluated from the current body transforms.
+	// Returns the smallest separation found, before correction.
+	float		SolvePositionConstraint(float slop, float correctionFactor, float maxCorrection);
+
+	// One soft pass of a substep, on the manifold of the start of the step with separations updated
+	// from the anchors. The relax pass (useBias false) removes the velocity added by the bias.
+	void		SolveSoftConstraint(std::vector<SSolverBody>& bodies, const SSoftStep& step, bool useBias);
+	// after the substeps, restitution isn't handled by the soft passes
+	void		ApplyRestitution(std::vector<SSolverBody>& bodies);
 
 	void		DebugDraw() const;
 
 private:
+	friend class CContactSolverSIMD;
+
+	float		GetSeparation(const SContact& contact, Vec2& rA, Vec2& rB, Vec2& n) const;
+
 	CPolygonPtr m_pA, m_pB;
+	unsigned int	m_bodyA, m_bodyB;
 
 	float		m_invMassA;
 	float		m_invMassB;
@@ -27,11 +82,13 @@ private:
 
 	size_t		m_manifoldSize;
 	SContact	m_manifold[2];
+	Vec2		m_localNormal; // in the reference body frame, or in world space when m_fixedNormal
 
 	Mat2		m_JWJT;
 	Mat2		m_JWJTInverse; // effective mass
 
 	bool		m_redundant;
+	bool		m_fixedNormal; // circle reference
 };
 
 #endif
\ No newline at end of file
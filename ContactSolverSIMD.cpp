@@ -0,0 +1,443 @@
+#include "ContactSolverSIMD.h"
+
+#include "MathsSIMD.h"
+
+#define INVALID_LANE ((unsigned int)-1)
+#define MAX_COLORS 64 // constraints that don't fit in a color get a batch of their own
+#define OVERFLOW_COLOR MAX_COLORS
+
+// Rows of a manifold point, from ROW_POINT_0 or ROW_POINT_1
+enum EPointRow
+{
+	POINT_RA_CROSS_N,
+	POINT_RB_CROSS_N,
+	POINT_RA_CROSS_T,
+	POINT_RB_CROSS_T,
+	POINT_NORMAL_MASS,	// 0 for the missing point of 1 point manifolds
+	POINT_TANGENT_MASS,
+	POINT_BIAS,
+	POINT_NORMAL_IMPULSE,
+	POINT_TANGENT_IMPULSE,
+	POINT_ROW_COUNT
+};
+
+// Rows of a batch, each row holds one value for every lane
+enum EBatchRow
+{
+	ROW_INV_MASS_A,
+	ROW_INV_MASS_B,
+	ROW_INV_TENSOR_A,
+	ROW_INV_TENSOR_B,
+	ROW_NORMAL_X,
+	ROW_NORMAL_Y,
+	ROW_BLOCK,			// 1 for 2 points manifolds solved as a LCP
+	ROW_A11,			// JWJT
+	ROW_A12,
+	ROW_A22,
+	ROW_INV_A11,		// inverse of JWJT
+	ROW_INV_A12,
+	ROW_INV_A22,
+	ROW_RCP_A11,		// 1 / a11, 1 / a22 for the single contact LCP cases
+	ROW_RCP_A22,
+	ROW_POINT_0,
+	ROW_POINT_1 = ROW_POINT_0 + POINT_ROW_COUNT,
+	ROW_COUNT = ROW_POINT_1 + POINT_ROW_COUNT
+};
+
+void	CContactSolverSIMD::Prepare(const std::vector<CContactConstraint>& contacts, const std::vector<SSolverBody>& bodies, size_t laneCount, float staticFriction)
+{
+	m_laneCount = laneCount;
+	m_staticFriction = staticFriction;
+
+	m_velocityX.resize(bodies.size() + 1);
+	m_velocityY.resize(bodies.size() + 1);
+	m_angularVelocity.resize(bodies.size() + 1);
+
+	m_velocityX[0] = m_velocityY[0] = m_angularVelocity[0] = 0.0f;
+	for (size_t i = 0; i < bodies.size(); ++i)
+	{
+		m_velocityX[i + 1] = bodies[i].speed.x;
+		m_velocityY[i + 1] = bodies[i].speed.y;
+		m_angularVelocity[i + 1] = bodies[i].angularVelocity;
+	}
+
+	BuildColors(contacts);
+
+	// batches of each color are contiguous, in color order
+	std::vector<size_t> colorFirstBatches(MAX_COLORS + 1);
+	m_batchCount = 0;
+	for (size_t color = 0; color <= MAX_COLORS; ++color)
+	{
+		colorFirstBatches[color] = m_batchCount;
+		m_batchCount += (color == OVERFLOW_COLOR) ? m_colorCounts[color] : (m_colorCounts[color] + m_laneCount - 1) / m_laneCount;
+	}
+
+	m_batchContacts.assign(m_batchCount * m_laneCount, INVALID_LANE);
+	m_batchBodiesA.assign(m_batchCount * m_laneCount, 0);
+	m_batchBodiesB.assign(m_batchCount * m_laneCount, 0);
+	m_batchRows.assign(m_batchCount * m_laneCount * ROW_COUNT, 0.0f);
+
+	std::vector<size_t> colorCursors(MAX_COLORS + 1, 0);
+	for (size_t i = 0; i < contacts.size(); ++i)
+	{
+		unsigned int color = m_contactColors[i];
+		size_t cursor = colorCursors[color]++;
+
+		size_t batch, lane;
+		if (color == OVERFLOW_COLOR)
+		{
+			batch = colorFirstBatches[color] + cursor;
+			lane = 0;
+		}
+		else
+		{
+			batch = colorFirstBatches[color] + cursor / m_laneCount;
+			lane = cursor % m_laneCount;
+		}
+
+		m_batchContacts[batch * m_laneCount + lane] = (unsigned int)i;
+		FillBatch(batch, lane, contacts[i]);
+	}
+}
+
+// Greedy coloring in constraint order, static and kinematic bodies are never written and can be shared
+void	CContactSolverSIMD::BuildColors(const std::vector<CContactConstraint>& contacts)
+{
+	m_bodyColors.assign(m_velocityX.size(), 0);
+	m_contactColors.resize(contacts.size());
+	m_colorCounts.assign(MAX_COLORS + 1, 0);
+
+	for (size_t i = 0; i < contacts.size(); ++i)
+	{
+		const CContactConstraint& contact = contacts[i];
+		unsigned int bodyA = contact.m_bodyA + 1;
+		unsigned int bodyB = contact.m_bodyB + 1;
+
+		unsigned long long usedColors = 0;
+		if (contact.m_invMassA > 0.0f)
+		{
+			usedColors |= m_bodyColors[bodyA];
+		}
+		if (contact.m_invMassB > 0.0f)
+		{
+			usedColors |= m_bodyColors[bodyB];
+		}
+
+		unsigned int color = 0;
+		while (color < MAX_COLORS && (usedColors & (1ull << color)))
+		{
+			++color;
+		}
+
+		if (color < MAX_COLORS)
+		{
+			m_bodyColors[bodyA] |= (1ull << color);
+			m_bodyColors[bodyB] |= (1ull << color);
+		}
+
+		m_contactColors[i] = color;
+		++m_colorCounts[color];
+	}
+}
+
+void	CContactSolverSIMD::FillBatch(size_t batch, size_t lane, const CContactConstraint& contact)
+{
+	m_batchBodiesA[batch * m_laneCount + lane] = contact.m_bodyA + 1;
+	m_batchBodiesB[batch * m_laneCount + lane] = contact.m_bodyB + 1;
+
+	auto setRow = [&](size_t row, float value)
+	{
+		GetRow(batch, row)[lane] = value;
+	};
+
+	const Vec2& n = contact.m_manifold[0].normal;
+
+	setRow(ROW_INV_MASS_A, contact.m_invMassA);
+	setRow(ROW_INV_MASS_B, contact.m_invMassB);
+	setRow(ROW_INV_TENSOR_A, contact.m_invTensorA);
+	setRow(ROW_INV_TENSOR_B, contact.m_invTensorB);
+	setRow(ROW_NORMAL_X, n.x);
+	setRow(ROW_NORMAL_Y, n.y);
+
+	for (size_t i = 0; i < contact.m_manifoldSize; ++i)
+	{
+		const SContact& point = contact.m_manifold[i];
+		size_t pointRow = (i == 0) ? ROW_POINT_0 : ROW_POINT_1;
+
+		setRow(pointRow + POINT_RA_CROSS_N, point.rACrossN);
+		setRow(pointRow + POINT_RB_CROSS_N, point.rBCrossN);
+		setRow(pointRow + POINT_RA_CROSS_T, point.rACrossT);
+		setRow(pointRow + POINT_RB_CROSS_T, point.rBCrossT);
+		setRow(pointRow + POINT_NORMAL_MASS, point.normalMass);
+		setRow(pointRow + POINT_TANGENT_MASS, point.tangentMass);
+		setRow(pointRow + POINT_BIAS, point.normalVelocityBias);
+		setRow(pointRow + POINT_NORMAL_IMPULSE, point.normalImpulse);
+		setRow(pointRow + POINT_TANGENT_IMPULSE, point.tangentImpulse);
+	}
+
+	if (contact.m_manifoldSize == 2 && !contact.m_redundant)
+	{
+		setRow(ROW_BLOCK, 1.0f);
+		setRow(ROW_A11, contact.m_JWJT.X.x);
+		setRow(ROW_A12, contact.m_JWJT.X.y);
+		setRow(ROW_A22, contact.m_JWJT.Y.y);
+		setRow(ROW_INV_A11, contact.m_JWJTInverse.X.x);
+		setRow(ROW_INV_A12, contact.m_JWJTInverse.X.y);
+		setRow(ROW_INV_A22, contact.m_JWJTInverse.Y.y);
+		setRow(ROW_RCP_A11, 1.0f / contact.m_JWJT.X.x);
+		setRow(ROW_RCP_A22, 1.0f / contact.m_JWJT.Y.y);
+	}
+}
+
+float*	CContactSolverSIMD::GetRow(size_t batch, size_t row)
+{
+	return &m_batchRows[(batch * ROW_COUNT + row) * m_laneCount];
+}
+
+size_t	CContactSolverSIMD::SolveVelocities(size_t minIterations, size_t maxIterations, float tolerance, float& residual)
+{
+	if (m_laneCount == SFloat8::LANE_COUNT)
+	{
+		return SolveVelocities<SFloat8>(minIterations, maxIterations, tolerance, residual);
+	}
+
+	return SolveVelocities<SFloat4>(minIterations, maxIterations, tolerance, residual);
+}
+
+// Same sequence as CContactConstraint::SolveVelocityConstraint, friction rows first,
+// then the 2 contacts LCP with a sequential fallback, for every lane at once
+template<typename TFloat>
+size_t	CContactSolverSIMD::SolveVelocities(size_t minIterations, size_t maxIterations, float tolerance, float& residual)
+{
+	const size_t N = TFloat::LANE_COUNT;
+	float lanes[N];
+
+	auto gather = [&](const std::vector<float>& values, const unsigned int* bodies)
+	{
+		for (size_t lane = 0; lane < N; ++lane)
+		{
+			lanes[lane] = values[bodies[lane]];
+		}
+		return TFloat::Load(lanes);
+	};
+
+	auto scatter = [&](std::vector<float>& values, const unsigned int* bodies, const TFloat& value)
+	{
+		value.Store(lanes);
+		for (size_t lane = 0; lane < N; ++lane)
+		{
+			values[bodies[lane]] = lanes[lane];
+		}
+	};
+
+	const TFloat zero(0.0f);
+	const TFloat friction(m_staticFriction);
+
+	residual = 0.0f;
+
+	size_t iteration = 0;
+	while (iteration < maxIterations)
+	{
+		TFloat maxVelocityChange = zero;
+
+		for (size_t batch = 0; batch < m_batchCount; ++batch)
+		{
+			const unsigned int* bodiesA = &m_batchBodiesA[batch * N];
+			const unsigned int* bodiesB = &m_batchBodiesB[batch * N];
+
+			TFloat vAx = gather(m_velocityX, bodiesA);
+			TFloat vAy = gather(m_velocityY, bodiesA);
+			TFloat wA = gather(m_angularVelocity, bodiesA);
+			TFloat vBx = gather(m_velocityX, bodiesB);
+			TFloat vBy = gather(m_velocityY, bodiesB);
+			TFloat wB = gather(m_angularVelocity, bodiesB);
+
+			auto loadRow = [&](size_t row) { return TFloat::Load(GetRow(batch, row)); };
+
+			TFloat invMassA = loadRow(ROW_INV_MASS_A);
+			TFloat invMassB = loadRow(ROW_INV_MASS_B);
+			TFloat invTensorA = loadRow(ROW_INV_TENSOR_A);
+			TFloat invTensorB = loadRow(ROW_INV_TENSOR_B);
+			TFloat nx = loadRow(ROW_NORMAL_X);
+			TFloat ny = loadRow(ROW_NORMAL_Y);
+			TFloat tx = -ny;
+			TFloat ty = nx;
+
+			TFloat maxLambda = zero;
+
+			auto applyImpulse = [&](const TFloat& dirX, const TFloat& dirY, const TFloat& rACross, const TFloat& rBCross, const TFloat& lambda)
+			{
+				vAx = vAx - dirX * invMassA * lambda;
+				vAy = vAy - dirY * invMassA * lambda;
+				wA = wA - rACross * invTensorA * lambda;
+				vBx = vBx + dirX * invMassB * lambda;
+				vBy = vBy + dirY * invMassB * lambda;
+				wB = wB + rBCross * invTensorB * lambda;
+			};
+
+			auto getRelativeVelocity = [&](const TFloat& dirX, const TFloat& dirY, const TFloat& rACross, const TFloat& rBCross)
+			{
+				return (dirX * vBx + dirY * vBy + rBCross * wB) - (dirX * vAx + dirY * vAy + rACross * wA);
+			};
+
+			// friction
+			for (size_t pointRow : { ROW_POINT_0, ROW_POINT_1 })
+			{
+				TFloat rACrossT = loadRow(pointRow + POINT_RA_CROSS_T);
+				TFloat rBCrossT = loadRow(pointRow + POINT_RB_CROSS_T);
+				TFloat normalImpulse = loadRow(pointRow + POINT_NORMAL_IMPULSE);
+				TFloat tangentImpulse = loadRow(pointRow + POINT_TANGENT_IMPULSE);
+
+				TFloat JV = getRelativeVelocity(tx, ty, rACrossT, rBCrossT);
+				TFloat lambda = -JV * loadRow(pointRow + POINT_TANGENT_MASS);
+
+				TFloat maxFriction = friction * normalImpulse;
+				TFloat newImpulse = Clamp(tangentImpulse + lambda, -maxFriction, maxFriction);
+				lambda = newImpulse - tangentImpulse;
+				newImpulse.Store(GetRow(batch, pointRow + POINT_TANGENT_IMPULSE));
+
+				maxLambda = Max(maxLambda, Max(lambda, -lambda));
+				applyImpulse(tx, ty, rACrossT, rBCrossT, lambda);
+			}
+
+			// non-penetration, 2 contacts LCP (see Solve2DLCP)
+			TFloat rA1CrossN = loadRow(ROW_POINT_0 + POINT_RA_CROSS_N);
+			TFloat rB1CrossN = loadRow(ROW_POINT_0 + POINT_RB_CROSS_N);
+			TFloat rA2CrossN = loadRow(ROW_POINT_1 + POINT_RA_CROSS_N);
+			TFloat rB2CrossN = loadRow(ROW_POINT_1 + POINT_RB_CROSS_N);
+			TFloat a1 = loadRow(ROW_POINT_0 + POINT_NORMAL_IMPULSE);
+			TFloat a2 = loadRow(ROW_POINT_1 + POINT_NORMAL_IMPULSE);
+			TFloat a11 = loadRow(ROW_A11);
+			TFloat a12 = loadRow(ROW_A12);
+			TFloat a22 = loadRow(ROW_A22);
+			TFloat invA11 = loadRow(ROW_INV_A11);
+			TFloat invA12 = loadRow(ROW_INV_A12);
+			TFloat invA22 = loadRow(ROW_INV_A22);
+
+			TFloat b1 = getRelativeVelocity(nx, ny, rA1CrossN, rB1CrossN) - loadRow(ROW_POINT_0 + POINT_BIAS) - (a11 * a1 + a12 * a2);
+			TFloat b2 = getRelativeVelocity(nx, ny, rA2CrossN, rB2CrossN) - loadRow(ROW_POINT_1 + POINT_BIAS) - (a12 * a1 + a22 * a2);
+
+			// both contacts active
+			TFloat x1 = -(invA11 * b1 + invA12 * b2);
+			TFloat x2 = -(invA12 * b1 + invA22 * b2);
+			TFloat caseBoth = (x1 >= zero) & (x2 >= zero);
+
+			// first contact only
+			TFloat first = -b1 * loadRow(ROW_RCP_A11);
+			TFloat caseFirst = (first >= zero) & ((a12 * first + b2) >= zero);
+
+			// second contact only
+			TFloat second = -b2 * loadRow(ROW_RCP_A22);
+			TFloat caseSecond = (second >= zero) & ((a12 * second + b1) >= zero);
+
+			// no contact
+			TFloat caseNone = (b1 >= zero) & (b2 >= zero);
+
+			TFloat blockSolved = (loadRow(ROW_BLOCK) > zero) & (caseBoth | caseFirst | caseSecond | caseNone);
+
+			x1 = Select(caseBoth, x1, Select(caseFirst, first, zero));
+			x2 = Select(caseBoth, x2, Select(caseFirst, zero, Select(caseSecond, second, zero)));
+
+			TFloat lambda1 = Select(blockSolved, x1 - a1, zero);
+			TFloat lambda2 = Select(blockSolved, x2 - a2, zero);
+			(a1 + lambda1).Store(GetRow(batch, ROW_POINT_0 + POINT_NORMAL_IMPULSE));
+			(a2 + lambda2).Store(GetRow(batch, ROW_POINT_1 + POINT_NORMAL_IMPULSE));
+
+			maxLambda = Max(maxLambda, Max(Max(lambda1, -lambda1), Max(lambda2, -lambda2)));
+			applyImpulse(nx, ny, rA1CrossN, rB1CrossN, lambda1);
+			applyImpulse(nx, ny, rA2CrossN, rB2CrossN, lambda2);
+
+			// sequential fallback, single contacts and unsolved LCP lanes
+			for (size_t pointRow : { ROW_POINT_0, ROW_POINT_1 })
+			{
+				TFloat rACrossN = loadRow(pointRow + POINT_RA_CROSS_N);
+				TFloat rBCrossN = loadRow(pointRow + POINT_RB_CROSS_N);
+				TFloat normalImpulse = loadRow(pointRow + POINT_NORMAL_IMPULSE);
+
+				TFloat JV = getRelativeVelocity(nx, ny, rACrossN, rBCrossN);
+				TFloat lambda = (loadRow(pointRow + POINT_BIAS) - JV) * loadRow(pointRow + POINT_NORMAL_MASS);
+				lambda = Select(blockSolved, zero, Max(-normalImpulse, lambda));
+				(normalImpulse + lambda).Store(GetRow(batch, pointRow + POINT_NORMAL_IMPULSE));
+
+				maxLambda = Max(maxLambda, Max(lambda, -lambda));
+				applyImpulse(nx, ny, rACrossN, rBCrossN, lambda);
+			}
+
+			maxVelocityChange = Max(maxVelocityChange, maxLambda * (invMassA + invMassB));
+
+			scatter(m_velocityX, bodiesA, vAx);
+			scatter(m_velocityY, bodiesA, vAy);
+			scatter(m_angularVelocity, bodiesA, wA);
+			scatter(m_velocityX, bodiesB, vBx);
+			scatter(m_velocityY, bodiesB, vBy);
+			scatter(m_angularVelocity, bodiesB, wB);
+		}
+
+		++iteration;
+
+		maxVelocityChange.Store(lanes);
+		float maxChange = 0.0f;
+		for (size_t lane = 0; lane < N; ++lane)
+		{
+			maxChange = Max(maxChange, lanes[lane]);
+		}
+
+		residual = maxChange;
+
+		if (maxChange <= tolerance && iteration >= minIterations)
+		{
+			break;
+		}
+	}
+
+	return iteration;
+}
+
+void	CContactSolverSIMD::Finish(std::vector<CContactConstraint>& contacts, std::vector<SSolverBody>& bodies)
+{
+	for (size_t batch = 0; batch < m_batchCount; ++batch)
+	{
+		for (size_t lane = 0; lane < m_laneCount; ++lane)
+		{
+			unsigned int contactIndex = m_batchContacts[batch * m_laneCount + lane];
+			if (contactIndex == INVALID_LANE)
+			{
+				continue;
+			}
+
+			CContactConstraint& contact = contacts[contactIndex];
+			for (size_t i = 0; i < contact.m_manifoldSize; ++i)
+			{
+				size_t pointRow = (i == 0) ? ROW_POINT_0 : ROW_POINT_1;
+				contact.m_manifold[i].normalImpulse = GetRow(batch, pointRow + POINT_NORMAL_IMPULSE)[lane];
+				contact.m_manifold[i].tangentImpulse = GetRow(batch, pointRow + POINT_TANGENT_IMPULSE)[lane];
+			}
+		}
+	}
+
+	// static and kinematic velocities are left untouched by the solve
+	for (size_t i = 0; i < bodies.size(); ++i)
+	{
+		if (bodies[i].invMass > 0.0f)
+		{
+			bodies[i].speed = Vec2(m_velocityX[i + 1], m_velocityY[i + 1]);
+			bodies[i].angularVelocity = m_angularVelocity[i + 1];
+		}
+	}
+}
+
+size_t	CContactSolverSIMD::GetColorCount() const
+{
+	size_t colorCount = 0;
+	for (size_t count : m_colorCounts)
+	{
+		colorCount += (count > 0) ? 1 : 0;
+	}
+
+	return colorCount;
+}
+
+size_t	CContactSolverSIMD::GetBatchCount() const
+{
+	return m_batchCount;
+}
\ No newline at end of file
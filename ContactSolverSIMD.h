@@ -0,0 +1,59 @@
+#ifndef _CONTACT_SOLVER_SIMD_H_
+#define _CONTACT_SOLVER_SIMD_H_
+
+#include <vector>
+
+#include "ContactConstraint.h"
+
+// Velocity solver running contact constraints in SSE (4 lanes) or AVX (8 lanes) batches.
+// Constraints are greedily colored so that no dynamic body appears twice in a color, each color
+// is cut in batches stored as struct of arrays (one row of lanes per constraint value) and the
+// solver body velocities are copied in struct of arrays as well for the solve.
+// Colors and batches only depend on the constraint order, so results are reproducible for a lane count.
+class CContactSolverSIMD
+{
+public:
+	// after InitVelocityConstraint and the warm starting impulses
+	void	Prepare(const std::vector<CContactConstraint>& contacts, const std::vector<SSolverBody>& bodies, size_t laneCount, float staticFriction);
+
+	// returns the number of iterations run, stops once no velocity changes more than the tolerance
+	// and minIterations are done. residual is the largest velocity change of the last iteration.
+	size_t	SolveVelocities(size_t minIterations, size_t maxIterations, float tolerance, float& residual);
+
+	// writes accumulated impulses back into the constraints and velocities into the bodies
+	void	Finish(std::vector<CContactConstraint>& contacts, std::vector<SSolverBody>& bodies);
+
+	size_t	GetColorCount() const;
+	size_t	GetBatchCount() const;
+
+private:
+	void			BuildColors(const std::vector<CContactConstraint>& contacts);
+	void			FillBatch(size_t batch, size_t lane, const CContactConstraint& contact);
+
+	float*			GetRow(size_t batch, size_t row);
+
+	template<typename TFloat>
+	size_t			SolveVelocities(size_t minIterations, size_t maxIterations, float tolerance, float& residual);
+
+	size_t						m_laneCount = 4;
+	float						m_staticFriction = 0.5f;
+
+	// velocities, index 0 is a still dummy body used by empty lanes, solver bodies follow
+	std::vector<float>			m_velocityX;
+	std::vector<float>			m_velocityY;
+	std::vector<float>			m_angularVelocity;
+
+	// coloring
+	std::vector<unsigned long long>	m_bodyColors; // colors used by each solver body
+	std::vector<unsigned int>	m_contactColors;
+	std::vector<size_t>			m_colorCounts;
+
+	// batches, constraint index of each lane (INVALID_LANE if empty), lane bodies and rows
+	std::vector<unsigned int>	m_batchContacts;
+	std::vector<unsigned int>	m_batchBodiesA;
+	std::vector<unsigned int>	m_batchBodiesB;
+	std::vector<float>			m_batchRows;
+	size_t						m_batchCount = 0;
+};
+
+#endif
\ No newline at end of file
@@ -1,7 +1,11 @@
 #ifndef __FLUID_MESH_H__
 #define __FLUID_MESH_H__
 
+#include <stddef.h>
+
+#ifndef PHYSIC_HEADLESS
 #include <GL/glew.h>
+#endif
 
 class CFluidMesh
 {
@@ -11,6 +15,7 @@ public:
 	template<class TFunctor>
 	void Fill(size_t count, TFunctor functor)
 	{
+#ifndef PHYSIC_HEADLESS
 		if (count > m_size)
 		{
 			SetSize(count);
@@ -26,10 +31,14 @@ public:
 		}
 
 		Unlock();
+#else
+		(void)count; (void)functor;
+#endif
 	}
 
 	void Draw()
 	{
+#ifndef PHYSIC_HEADLESS
 		if (m_size == 0)
 		{
 			return;
@@ -59,6 +68,7 @@ public:
 		glBindBuffer(GL_ARRAY_BUFFER, 0);
 
 		glPopMatrix();
+#endif
 	}
 
 private:
@@ -74,6 +84,7 @@ private:
 
 	void Create()
 	{
+#ifndef PHYSIC_HEADLESS
 		if (m_size == 0)
 		{
 			return;
@@ -87,32 +98,41 @@ private:
 		glBufferData(GL_ARRAY_BUFFER, sizeof(float) * stride * m_size, nullptr, GL_STATIC_DRAW);
 
 		glBindBuffer(GL_ARRAY_BUFFER, 0);
+#endif
 	}
 
 	void Destroy()
 	{
+#ifndef PHYSIC_HEADLESS
 		if (m_vertexBufferId != 0)
 		{
 			glDeleteBuffers(1, &m_vertexBufferId);
 			m_vertexBufferId = 0;
 		}
+#endif
 	}
 
 	float*	Lock()
 	{
+#ifndef PHYSIC_HEADLESS
 		glBindBuffer(GL_ARRAY_BUFFER, m_vertexBufferId);
 		return (float*)glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
+#else
+		return nullptr;
+#endif
 	}
 
 	void Unlock()
 	{
+#ifndef PHYSIC_HEADLESS
 		glUnmapBuffer(GL_ARRAY_BUFFER);
 		glBindBuffer(GL_ARRAY_BUFFER, 0);
+#endif
 	}
 
 private:
 	size_t				m_size = 0;
-	GLuint				m_vertexBufferId = 0;
+	unsigned int		m_vertexBufferId = 0;
 	
 };
 
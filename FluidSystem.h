@@ -186,7 +186,10 @@ public:
 		}
 
 		BorderCollisions();
+	}
 
+	void Render()
+	{
 		FillMesh();
 		m_mesh.Draw();
 	}
@@ -9,6 +9,8 @@ struct SGlobalVariables
 	class CSceneManager*	pSceneManager;
 	class CPhysicEngine*	pPhysicEngine;
 	class CFluidSystem*		pFluidSystem;
+	class CProfiler*		pProfiler;
+	class CTraceRecorder*	pTraceRecorder;
 
 	bool					bDebug;
 };
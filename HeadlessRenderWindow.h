@@ -0,0 +1,21 @@
+#ifndef _RENDER_WINDOW_HEADLESS_H_
+#define _RENDER_WINDOW_HEADLESS_H_
+
+#include "RenderWindow.h"
+
+// Window without display nor input, only provides the viewport size used to compute world bounds
+class CHeadlessRenderWindow : public CRenderWindow
+{
+public:
+	CHeadlessRenderWindow(int width, int height)
+		: CRenderWindow(width, height){}
+
+	virtual void	Init() override{}
+
+	virtual Vec2	GetMousePos() override				{ return Vec2(); }
+	virtual bool	GetMouseButton(int) override		{ return false; }
+	virtual bool	IsPressingKey(Key) override			{ return false; }
+	virtual bool	JustPressedKey(Key) override		{ return false; }
+};
+
+#endif
\ No newline at end of file
@@ -51,30 +51,13 @@ float ComputeInertiaTensor_BaseHalfbaseHeight(float b, float a, float h)
 	return (b3 * h - b2 * h * a + b * h *a2 + b * h3) * (1.0f / 36.0f);
 }
 
-// consider A is the center of gravity
+// polar moment of area around A, signed like the area of ABC
 float	ComputeInertiaTensor_Triangle(const Vec2& A, const Vec2& B, const Vec2& C)
 {
 	Vec2 AB = B - A;
 	Vec2 AC = C - A;
 
-	Vec2 G = (A + B + C) / 3.0f;
-
-	float base, halfBase, height;
-	if (AB.GetSqrLength() >= AC.GetSqrLength())
-	{
-		base = AB.GetLength();
-		halfBase = AC | (AB / base);
-		height = (AC - AB * (halfBase / base)).GetLength();
-	}
-	else
-	{
-		base = AC.GetLength();
-		halfBase = AB | (AC / base);
-		height = (AB - AC * (halfBase / base)).GetLength();
-	}
-
-
-	return ComputeInertiaTensor_BaseHalfbaseHeight(base, halfBase, height) + (G - A).GetSqrLength();
+	return (AB ^ AC) * ((AB | AB) + (AB | AC) + (AC | AC)) * (1.0f / 12.0f);
 }
 
 
@@ -6,7 +6,7 @@
 // A is being considered as the centered of gravity
 float	ComputeInertiaTensor_BaseHalfbaseHeight(float b, float a, float h);
 
-// consider A is the center of gravity
+// polar moment of area around A, signed like the area of ABC
 float	ComputeInertiaTensor_Triangle(const Vec2& A, const Vec2& B, const Vec2& C);
 
 
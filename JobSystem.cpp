@@ -0,0 +1,100 @@
+#include "JobSystem.h"
+
+#define WORKER_SPIN_COUNT 2000 // yields before a worker goes to sleep
+
+CJobSystem::~CJobSystem()
+{
+	Stop();
+}
+
+void	CJobSystem::Start(size_t workerCount)
+{
+	Stop();
+
+	m_stop = false;
+	for (size_t i = 0; i < workerCount; ++i)
+	{
+		m_workers.push_back(std::thread(&CJobSystem::WorkerLoop, this, m_generation.load()));
+	}
+}
+
+void	CJobSystem::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+		++m_generation;
+	}
+	m_wakeUp.notify_all();
+
+	for (std::thread& worker : m_workers)
+	{
+		worker.join();
+	}
+	m_workers.clear();
+}
+
+size_t	CJobSystem::GetThreadCount() const
+{
+	return m_workers.size() + 1;
+}
+
+// Every worker takes part in every call, so none can be left behind working on a previous task
+void	CJobSystem::Run(size_t count)
+{
+	m_taskCount = count;
+	m_nextTask = 0;
+	m_pendingWorkers = m_workers.size();
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		++m_generation;
+	}
+	m_wakeUp.notify_all();
+
+	ExecuteTasks();
+
+	while (m_pendingWorkers.load(std::memory_order_acquire) > 0)
+	{
+		std::this_thread::yield();
+	}
+}
+
+void	CJobSystem::WorkerLoop(size_t generation)
+{
+	for (;;)
+	{
+		for (size_t spin = 0; spin < WORKER_SPIN_COUNT && m_generation.load(std::memory_order_acquire) == generation; ++spin)
+		{
+			std::this_thread::yield();
+		}
+
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wakeUp.wait(lock, [&]() { return m_generation != generation; });
+			generation = m_generation;
+
+			if (m_stop)
+			{
+				return;
+			}
+		}
+
+		ExecuteTasks();
+		m_pendingWorkers.fetch_sub(1, std::memory_order_release);
+	}
+}
+
+void	CJobSystem::ExecuteTasks()
+{
+	for (;;)
+	{
+		size_t index = m_nextTask.fetch_add(1);
+		if (index >= m_taskCount)
+		{
+			return;
+		}
+
+		m_task(index);
+	}
+}
\ No newline at end of file
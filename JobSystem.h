@@ -0,0 +1,59 @@
+#ifndef _JOB_SYSTEM_H_
+#define _JOB_SYSTEM_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fork-join worker pool. ParallelFor hands out indices to the workers and the calling
+// thread, and returns once every worker is done, which makes it a barrier as well.
+// Workers spin for a short while between calls before sleeping, barriers are frequent in the solver.
+// Calls can't be nested and must come from a single thread.
+class CJobSystem
+{
+public:
+	~CJobSystem();
+
+	void	Start(size_t workerCount);
+	void	Stop();
+
+	size_t	GetThreadCount() const; // workers and the calling thread
+
+	template<typename TFunctor>
+	void	ParallelFor(size_t count, TFunctor functor)
+	{
+		if (m_workers.empty() || count <= 1)
+		{
+			for (size_t i = 0; i < count; ++i)
+			{
+				functor(i);
+			}
+			return;
+		}
+
+		m_task = functor;
+		Run(count);
+		m_task = nullptr;
+	}
+
+private:
+	void	Run(size_t count);
+	void	WorkerLoop(size_t generation);
+	void	ExecuteTasks();
+
+	std::vector<std::thread>		m_workers;
+	std::function<void(size_t)>		m_task;
+	size_t							m_taskCount = 0;
+	std::atomic<size_t>				m_nextTask{ 0 };
+	std::atomic<size_t>				m_pendingWorkers{ 0 };
+
+	std::mutex						m_mutex;
+	std::condition_variable			m_wakeUp;
+	std::atomic<size_t>				m_generation{ 0 };
+	bool							m_stop = false;
+};
+
+#endif
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include "Maths.h"
 
+#include <float.h>
 #include <stdlib.h>
 #include <cmath>
 
@@ -29,14 +30,14 @@ Vec2 maxv(const Vec2& a, const Vec2& b)
 	return Vec2(Max(a.x, b.x), Max(a.y, b.y));
 }
 
-bool Clip(const Vec2& center, const Vec2& normal, Vec2& pt1, Vec2& pt2)
+int Clip(const Vec2& center, const Vec2& normal, Vec2& pt1, Vec2& pt2)
 {
 	float dist1 = (pt1 - center) | normal;
 	float dist2 = (pt2 - center) | normal;
 
 	if (dist1 * dist2 >= 0.0f)
 	{
-		return false;
+		return -1;
 	}
 
 	Vec2 *pIn, *pOut;
@@ -54,7 +55,64 @@ bool Clip(const Vec2& center, const Vec2& normal, Vec2& pt1, Vec2& pt2)
 	float k = ((center - *pIn) | normal) / ((*pOut - *pIn) | normal);
 	*pIn += (*pOut - *pIn) * k;
 
-	return true;
+	return (pIn == &pt1) ? 0 : 1;
+}
+
+float ClosestSegmentFraction(const Vec2& start, const Vec2& end, const Vec2& point)
+{
+	Vec2 dir = end - start;
+	float sqrLength = dir.GetSqrLength();
+	if (sqrLength <= FLT_EPSILON)
+	{
+		return 0.0f;
+	}
+
+	return Clamp(((point - start) | dir) / sqrLength, 0.0f, 1.0f);
+}
+
+// Minimizes the distance over fraction1 and clamps, then moves fraction2 to the closest point
+// of the clamped one, re-clamping fraction1 if fraction2 left the segment
+void ClosestSegmentsFractions(const Vec2& start1, const Vec2& end1, const Vec2& start2, const Vec2& end2, float& fraction1, float& fraction2)
+{
+	Vec2 dir1 = end1 - start1;
+	Vec2 dir2 = end2 - start2;
+	Vec2 offset = start1 - start2;
+	float sqrLength1 = dir1.GetSqrLength();
+	float sqrLength2 = dir2.GetSqrLength();
+	float dot2 = dir2 | offset;
+
+	if (sqrLength1 <= FLT_EPSILON)
+	{
+		fraction1 = 0.0f;
+		fraction2 = (sqrLength2 <= FLT_EPSILON) ? 0.0f : Clamp(dot2 / sqrLength2, 0.0f, 1.0f);
+		return;
+	}
+
+	float dot1 = dir1 | offset;
+	if (sqrLength2 <= FLT_EPSILON)
+	{
+		fraction1 = Clamp(-dot1 / sqrLength1, 0.0f, 1.0f);
+		fraction2 = 0.0f;
+		return;
+	}
+
+	float dot12 = dir1 | dir2;
+	float denominator = sqrLength1 * sqrLength2 - dot12 * dot12;
+
+	// parallel segments have no single closest point, any fraction works
+	fraction1 = (denominator > 0.0f) ? Clamp((dot12 * dot2 - dot1 * sqrLength2) / denominator, 0.0f, 1.0f) : 0.0f;
+	fraction2 = (dot12 * fraction1 + dot2) / sqrLength2;
+
+	if (fraction2 < 0.0f)
+	{
+		fraction2 = 0.0f;
+		fraction1 = Clamp(-dot1 / sqrLength1, 0.0f, 1.0f);
+	}
+	else if (fraction2 > 1.0f)
+	{
+		fraction2 = 1.0f;
+		fraction1 = Clamp((dot12 - dot1) / sqrLength1, 0.0f, 1.0f);
+	}
 }
 
 // 2D Analytic LCP solver (find exact solution)
@@ -214,7 +214,13 @@ struct Mat2
 };
 
 // make sure that pt1 and pt2 are not clipping through
-bool Clip(const Vec2& center, const Vec2& normal, Vec2& pt1, Vec2& pt2);
+// Moves the point behind the plane onto it, returns its index (0 or 1), -1 if none was clipped
+int Clip(const Vec2& center, const Vec2& normal, Vec2& pt1, Vec2& pt2);
+
+// Fraction along [start, end] of its closest point to point
+float ClosestSegmentFraction(const Vec2& start, const Vec2& end, const Vec2& point);
+// Fractions along [start1, end1] and [start2, end2] of the closest points between them
+void ClosestSegmentsFractions(const Vec2& start1, const Vec2& end1, const Vec2& start2, const Vec2& end2, float& fraction1, float& fraction2);
 
 struct Line
 {
@@ -287,11 +293,29 @@ struct AABB
 		max = maxv(max, point);
 	}
 
-	bool Intersect(const AABB& aabb)
+	bool Intersect(const AABB& aabb) const
 	{
 		bool separateAxis = (min.x > aabb.max.x) || (min.y > aabb.max.y) || (aabb.min.x > max.x) || (aabb.min.y > max.y);
 		return !separateAxis;
 	}
+
+	bool Contains(const AABB& aabb) const
+	{
+		return (min.x <= aabb.min.x) && (min.y <= aabb.min.y) && (aabb.max.x <= max.x) && (aabb.max.y <= max.y);
+	}
+
+	AABB Merge(const AABB& aabb) const
+	{
+		AABB res;
+		res.min = minv(min, aabb.min);
+		res.max = maxv(max, aabb.max);
+		return res;
+	}
+
+	float GetPerimeter() const
+	{
+		return 2.0f * ((max.x - min.x) + (max.y - min.y));
+	}
 };
 
 // 2D Analytic LCP solver (find exact solution)
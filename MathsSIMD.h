@@ -0,0 +1,142 @@
+#ifndef _MATHS_SIMD_H_
+#define _MATHS_SIMD_H_
+
+#include <immintrin.h>
+#include "Maths.h"
+
+// Packed floats for the SoA solvers, lane operations only (no FMA, no approximations)
+// so results don't depend on the instruction set for a given lane count.
+// Comparisons return lane masks (all bits set or cleared) consumed by Select, & and |,
+// Clamp from Maths.h picks the packed Min / Max.
+
+struct SFloat4
+{
+	static const size_t LANE_COUNT = 4;
+
+	__m128 v;
+
+	SFloat4() {}
+	SFloat4(__m128 _v) : v(_v) {}
+	SFloat4(float f) : v(_mm_set1_ps(f)) {}
+
+	static SFloat4 Load(const float* src) { return _mm_loadu_ps(src); }
+	void Store(float* dst) const { _mm_storeu_ps(dst, v); }
+
+	SFloat4 operator+(const SFloat4& rhs) const { return _mm_add_ps(v, rhs.v); }
+	SFloat4 operator-(const SFloat4& rhs) const { return _mm_sub_ps(v, rhs.v); }
+	SFloat4 operator*(const SFloat4& rhs) const { return _mm_mul_ps(v, rhs.v); }
+	SFloat4 operator/(const SFloat4& rhs) const { return _mm_div_ps(v, rhs.v); }
+	SFloat4 operator-() const { return _mm_sub_ps(_mm_setzero_ps(), v); }
+
+	SFloat4 operator<(const SFloat4& rhs) const { return _mm_cmplt_ps(v, rhs.v); }
+	SFloat4 operator>(const SFloat4& rhs) const { return _mm_cmpgt_ps(v, rhs.v); }
+	SFloat4 operator>=(const SFloat4& rhs) const { return _mm_cmpge_ps(v, rhs.v); }
+	SFloat4 operator&(const SFloat4& rhs) const { return _mm_and_ps(v, rhs.v); }
+	SFloat4 operator|(const SFloat4& rhs) const { return _mm_or_ps(v, rhs.v); }
+};
+
+inline SFloat4 Select(const SFloat4& mask, const SFloat4& a, const SFloat4& b)
+{
+	return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v));
+}
+
+inline SFloat4 Min(const SFloat4& a, const SFloat4& b)
+{
+	return _mm_min_ps(a.v, b.v);
+}
+
+inline SFloat4 Max(const SFloat4& a, const SFloat4& b)
+{
+	return _mm_max_ps(a.v, b.v);
+}
+
+#if defined(__AVX__)
+
+struct SFloat8
+{
+	static const size_t LANE_COUNT = 8;
+
+	__m256 v;
+
+	SFloat8() {}
+	SFloat8(__m256 _v) : v(_v) {}
+	SFloat8(float f) : v(_mm256_set1_ps(f)) {}
+
+	static SFloat8 Load(const float* src) { return _mm256_loadu_ps(src); }
+	void Store(float* dst) const { _mm256_storeu_ps(dst, v); }
+
+	SFloat8 operator+(const SFloat8& rhs) const { return _mm256_add_ps(v, rhs.v); }
+	SFloat8 operator-(const SFloat8& rhs) const { return _mm256_sub_ps(v, rhs.v); }
+	SFloat8 operator*(const SFloat8& rhs) const { return _mm256_mul_ps(v, rhs.v); }
+	SFloat8 operator/(const SFloat8& rhs) const { return _mm256_div_ps(v, rhs.v); }
+	SFloat8 operator-() const { return _mm256_sub_ps(_mm256_setzero_ps(), v); }
+
+	SFloat8 operator<(const SFloat8& rhs) const { return _mm256_cmp_ps(v, rhs.v, _CMP_LT_OQ); }
+	SFloat8 operator>(const SFloat8& rhs) const { return _mm256_cmp_ps(v, rhs.v, _CMP_GT_OQ); }
+	SFloat8 operator>=(const SFloat8& rhs) const { return _mm256_cmp_ps(v, rhs.v, _CMP_GE_OQ); }
+	SFloat8 operator&(const SFloat8& rhs) const { return _mm256_and_ps(v, rhs.v); }
+	SFloat8 operator|(const SFloat8& rhs) const { return _mm256_or_ps(v, rhs.v); }
+};
+
+inline SFloat8 Select(const SFloat8& mask, const SFloat8& a, const SFloat8& b)
+{
+	return _mm256_blendv_ps(b.v, a.v, mask.v);
+}
+
+inline SFloat8 Min(const SFloat8& a, const SFloat8& b)
+{
+	return _mm256_min_ps(a.v, b.v);
+}
+
+inline SFloat8 Max(const SFloat8& a, const SFloat8& b)
+{
+	return _mm256_max_ps(a.v, b.v);
+}
+
+#else
+
+// without AVX, 8 lanes run as 2 SSE halves
+struct SFloat8
+{
+	static const size_t LANE_COUNT = 8;
+
+	SFloat4 lo, hi;
+
+	SFloat8() {}
+	SFloat8(const SFloat4& _lo, const SFloat4& _hi) : lo(_lo), hi(_hi) {}
+	SFloat8(float f) : lo(f), hi(f) {}
+
+	static SFloat8 Load(const float* src) { return SFloat8(SFloat4::Load(src), SFloat4::Load(src + 4)); }
+	void Store(float* dst) const { lo.Store(dst); hi.Store(dst + 4); }
+
+	SFloat8 operator+(const SFloat8& rhs) const { return SFloat8(lo + rhs.lo, hi + rhs.hi); }
+	SFloat8 operator-(const SFloat8& rhs) const { return SFloat8(lo - rhs.lo, hi - rhs.hi); }
+	SFloat8 operator*(const SFloat8& rhs) const { return SFloat8(lo * rhs.lo, hi * rhs.hi); }
+	SFloat8 operator/(const SFloat8& rhs) const { return SFloat8(lo / rhs.lo, hi / rhs.hi); }
+	SFloat8 operator-() const { return SFloat8(-lo, -hi); }
+
+	SFloat8 operator<(const SFloat8& rhs) const { return SFloat8(lo < rhs.lo, hi < rhs.hi); }
+	SFloat8 operator>(const SFloat8& rhs) const { return SFloat8(lo > rhs.lo, hi > rhs.hi); }
+	SFloat8 operator>=(const SFloat8& rhs) const { return SFloat8(lo >= rhs.lo, hi >= rhs.hi); }
+	SFloat8 operator&(const SFloat8& rhs) const { return SFloat8(lo & rhs.lo, hi & rhs.hi); }
+	SFloat8 operator|(const SFloat8& rhs) const { return SFloat8(lo | rhs.lo, hi | rhs.hi); }
+};
+
+inline SFloat8 Select(const SFloat8& mask, const SFloat8& a, const SFloat8& b)
+{
+	return SFloat8(Select(mask.lo, a.lo, b.lo), Select(mask.hi, a.hi, b.hi));
+}
+
+inline SFloat8 Min(const SFloat8& a, const SFloat8& b)
+{
+	return SFloat8(Min(a.lo, b.lo), Min(a.hi, b.hi));
+}
+
+inline SFloat8 Max(const SFloat8& a, const SFloat8& b)
+{
+	return SFloat8(Max(a.lo, b.lo), Max(a.hi, b.hi));
+}
+
+#endif
+
+#endif
\ No newline at end of file
@@ -0,0 +1,631 @@
+#include "NarrowPhaseGJK.h"
+
+#include <float.h>
+#include <utility>
+
+#include "ShapeCollision.h"
+
+#define GJK_MAX_ITERATIONS 20
+#define EPA_MAX_ITERATIONS 32
+#define EPA_MAX_VERTICES (EPA_MAX_ITERATIONS + 3)
+#define EPA_TOLERANCE 1e-4f
+// an edge separating by this much less than the GJK / EPA separation still gives a clipped manifold
+#define GJK_FACE_TOLERANCE 0.005f
+// the reference edge is only taken on B when it is clearly more separating, keeps the choice stable
+#define GJK_FACE_PREFERENCE 0.001f
+
+// Circles are a single core vertex at their position
+static size_t GetCoreVertexCount(const CPolygon& poly)
+{
+	return poly.points.empty() ? 1 : poly.points.size();
+}
+
+static Vec2 GetCoreVertex(const CPolygon& poly, size_t index)
+{
+	return poly.points.empty() ? poly.position : poly.GetWorldVertex(index);
+}
+
+// Hill climbs from startIndex on polygons with many vertices, the previous simplex is usually next to the answer
+static size_t GetSupportIndex(const CPolygon& poly, const Vec2& dir, size_t startIndex)
+{
+	size_t count = poly.points.size();
+	auto project = [&](size_t i)
+	{
+		NARROWPHASE_STAT(gNarrowPhaseStats.verticesTouched++);
+		return poly.GetWorldVertex(i) | dir;
+	};
+
+	if (count < HILL_CLIMB_MIN_VERTICES)
+	{
+		size_t bestIndex = 0;
+		float bestSupport = -FLT_MAX;
+		for (size_t i = 0; i < count; ++i)
+		{
+			float support = project(i);
+			bestIndex = Select(support > bestSupport, i, bestIndex);
+			bestSupport = Max(support, bestSupport);
+		}
+		return bestIndex;
+	}
+
+	size_t index = (startIndex < count) ? startIndex : 0;
+	float support = project(index);
+	for (size_t step : { (size_t)1, count - 1 })
+	{
+		bool climbed = false;
+		for (;;)
+		{
+			size_t next = (index + step) % count;
+			float nextSupport = project(next);
+			if (nextSupport <= support)
+			{
+				break;
+			}
+
+			index = next;
+			support = nextSupport;
+			climbed = true;
+		}
+
+		if (climbed)
+		{
+			break;
+		}
+	}
+
+	return index;
+}
+
+// Point of the Minkowski difference B - A
+struct SSimplexVertex
+{
+	Vec2	wA;
+	Vec2	wB;
+	Vec2	w; // wB - wA
+	float	a; // barycentric coordinate of the closest point
+	size_t	indexA;
+	size_t	indexB;
+
+	void	Set(const CPolygon& polyA, const CPolygon& polyB, size_t _indexA, size_t _indexB)
+	{
+		indexA = _indexA;
+		indexB = _indexB;
+		wA = GetCoreVertex(polyA, indexA);
+		wB = GetCoreVertex(polyB, indexB);
+		w = wB - wA;
+		a = 1.0f;
+	}
+};
+
+// Closest point to the origin of a point, segment or triangle, by the signed volumes of its sub simplices
+struct SSimplex
+{
+	SSimplexVertex	v[3];
+	size_t			count;
+
+	void	ReadCache(const SSimplexCache* cache, const CPolygon& polyA, const CPolygon& polyB)
+	{
+		count = 0;
+		if (cache)
+		{
+			for (size_t i = 0; i < cache->count; ++i)
+			{
+				if (cache->indexA[i] >= GetCoreVertexCount(polyA) || cache->indexB[i] >= GetCoreVertexCount(polyB))
+				{
+					count = 0;
+					break;
+				}
+				v[count++].Set(polyA, polyB, cache->indexA[i], cache->indexB[i]);
+			}
+		}
+
+		// the bodies moved since the cache was written, a degenerate simplex is started over
+		if (count == 2 && (v[1].w - v[0].w).GetSqrLength() < FLT_EPSILON)
+		{
+			count = 1;
+		}
+		else if (count == 3 && fabsf((v[1].w - v[0].w) ^ (v[2].w - v[0].w)) < FLT_EPSILON)
+		{
+			count = 1;
+		}
+
+		if (count == 0)
+		{
+			v[0].Set(polyA, polyB, 0, 0);
+			count = 1;
+		}
+	}
+
+	void	WriteCache(SSimplexCache* cache) const
+	{
+		if (cache)
+		{
+			cache->count = (unsigned char)count;
+			for (size_t i = 0; i < count; ++i)
+			{
+				cache->indexA[i] = (unsigned short)v[i].indexA;
+				cache->indexB[i] = (unsigned short)v[i].indexB;
+			}
+		}
+	}
+
+	Vec2	GetSearchDirection() const
+	{
+		if (count == 1)
+		{
+			return v[0].w * -1.0f;
+		}
+
+		// towards the origin side of the segment
+		Vec2 edge = v[1].w - v[0].w;
+		return ((edge ^ (v[0].w * -1.0f)) > 0.0f) ? edge.GetNormal() : edge.GetNormal() * -1.0f;
+	}
+
+	void	GetWitnessPoints(Vec2& pointA, Vec2& pointB) const
+	{
+		pointA = Vec2();
+		pointB = Vec2();
+		for (size_t i = 0; i < count; ++i)
+		{
+			pointA += v[i].wA * v[i].a;
+			pointB += v[i].wB * v[i].a;
+		}
+
+		if (count == 3)
+		{
+			pointB = pointA;
+		}
+	}
+
+	void	Solve2()
+	{
+		Vec2 w1 = v[0].w;
+		Vec2 w2 = v[1].w;
+		Vec2 e12 = w2 - w1;
+
+		// w1 region
+		float d12_2 = -(w1 | e12);
+		if (d12_2 <= 0.0f)
+		{
+			v[0].a = 1.0f;
+			count = 1;
+			return;
+		}
+
+		// w2 region
+		float d12_1 = w2 | e12;
+		if (d12_1 <= 0.0f)
+		{
+			v[1].a = 1.0f;
+			v[0] = v[1];
+			count = 1;
+			return;
+		}
+
+		float invD12 = 1.0f / (d12_1 + d12_2);
+		v[0].a = d12_1 * invD12;
+		v[1].a = d12_2 * invD12;
+		count = 2;
+	}
+
+	void	Solve3()
+	{
+		Vec2 w1 = v[0].w;
+		Vec2 w2 = v[1].w;
+		Vec2 w3 = v[2].w;
+
+		Vec2 e12 = w2 - w1;
+		float d12_1 = w2 | e12;
+		float d12_2 = -(w1 | e12);
+
+		Vec2 e13 = w3 - w1;
+		float d13_1 = w3 | e13;
+		float d13_2 = -(w1 | e13);
+
+		Vec2 e23 = w3 - w2;
+		float d23_1 = w3 | e23;
+		float d23_2 = -(w2 | e23);
+
+		float n123 = e12 ^ e13;
+		float d123_1 = n123 * (w2 ^ w3);
+		float d123_2 = n123 * (w3 ^ w1);
+		float d123_3 = n123 * (w1 ^ w2);
+
+		// w1 region
+		if (d12_2 <= 0.0f && d13_2 <= 0.0f)
+		{
+			v[0].a = 1.0f;
+			count = 1;
+			return;
+		}
+
+		// e12
+		if (d12_1 > 0.0f && d12_2 > 0.0f && d123_3 <= 0.0f)
+		{
+			float invD12 = 1.0f / (d12_1 + d12_2);
+			v[0].a = d12_1 * invD12;
+			v[1].a = d12_2 * invD12;
+			count = 2;
+			return;
+		}
+
+		// e13
+		if (d13_1 > 0.0f && d13_2 > 0.0f && d123_2 <= 0.0f)
+		{
+			float invD13 = 1.0f / (d13_1 + d13_2);
+			v[0].a = d13_1 * invD13;
+			v[2].a = d13_2 * invD13;
+			v[1] = v[2];
+			count = 2;
+			return;
+		}
+
+		// w2 region
+		if (d12_1 <= 0.0f && d23_2 <= 0.0f)
+		{
+			v[1].a = 1.0f;
+			v[0] = v[1];
+			count = 1;
+			return;
+		}
+
+		// w3 region
+		if (d13_1 <= 0.0f && d23_1 <= 0.0f)
+		{
+			v[2].a = 1.0f;
+			v[0] = v[2];
+			count = 1;
+			return;
+		}
+
+		// e23
+		if (d23_1 > 0.0f && d23_2 > 0.0f && d123_1 <= 0.0f)
+		{
+			float invD23 = 1.0f / (d23_1 + d23_2);
+			v[1].a = d23_1 * invD23;
+			v[2].a = d23_2 * invD23;
+			v[0] = v[2];
+			count = 2;
+			return;
+		}
+
+		// the origin is inside the triangle
+		float invD123 = 1.0f / (d123_1 + d123_2 + d123_3);
+		v[0].a = d123_1 * invD123;
+		v[1].a = d123_2 * invD123;
+		v[2].a = d123_3 * invD123;
+		count = 3;
+	}
+};
+
+// Returns the simplex, a triangle holding the origin when the cores overlap
+static SSimplex RunGJK(const CPolygon& polyA, const CPolygon& polyB, SDistanceOutput& output, SSimplexCache* cache)
+{
+	polyA.UpdateWorldGeometry();
+	polyB.UpdateWorldGeometry();
+
+	SSimplex simplex;
+	simplex.ReadCache(cache, polyA, polyB);
+
+	size_t iteration = 0;
+	while (iteration < GJK_MAX_ITERATIONS)
+	{
+		// vertices of the last simplex, a new support point among them means no progress
+		size_t saveCount = simplex.count;
+		size_t saveA[3], saveB[3];
+		for (size_t i = 0; i < saveCount; ++i)
+		{
+			saveA[i] = simplex.v[i].indexA;
+			saveB[i] = simplex.v[i].indexB;
+		}
+
+		if (simplex.count == 2)
+		{
+			simplex.Solve2();
+		}
+		else if (simplex.count == 3)
+		{
+			simplex.Solve3();
+		}
+
+		if (simplex.count == 3)
+		{
+			break;
+		}
+
+		// the origin is on the simplex
+		Vec2 dir = simplex.GetSearchDirection();
+		if (dir.GetSqrLength() < FLT_EPSILON * FLT_EPSILON)
+		{
+			break;
+		}
+
+		SSimplexVertex& vertex = simplex.v[simplex.count];
+		size_t startA = simplex.v[0].indexA;
+		size_t startB = simplex.v[0].indexB;
+		vertex.Set(polyA, polyB, GetSupportIndex(polyA, dir * -1.0f, startA), GetSupportIndex(polyB, dir, startB));
+		++iteration;
+
+		bool duplicate = false;
+		for (size_t i = 0; i < saveCount; ++i)
+		{
+			duplicate = duplicate || (vertex.indexA == saveA[i] && vertex.indexB == saveB[i]);
+		}
+		if (duplicate)
+		{
+			break;
+		}
+
+		++simplex.count;
+	}
+
+	NARROWPHASE_STAT(gNarrowPhaseStats.gjkIterations += iteration);
+
+	simplex.GetWitnessPoints(output.pointA, output.pointB);
+	output.distance = (simplex.count == 3) ? 0.0f : (output.pointB - output.pointA).GetLength();
+	output.iterations = iteration;
+	simplex.WriteCache(cache);
+
+	return simplex;
+}
+
+void ComputeDistanceGJK(const CPolygon& polyA, const CPolygon& polyB, SDistanceOutput& output, SSimplexCache* cache)
+{
+	RunGJK(polyA, polyB, output, cache);
+}
+
+// Expands the GJK simplex inside B - A up to the boundary edge closest to the origin. Returns the penetration
+// depth, normal is the outward normal of that edge (from B towards A) and the points are the witnesses on the cores.
+static float RunEPA(const CPolygon& polyA, const CPolygon& polyB, const SSimplex& simplex, Vec2& normal, Vec2& pointA, Vec2& pointB)
+{
+	SSimplexVertex polytope[EPA_MAX_VERTICES];
+	size_t count = simplex.count;
+	for (size_t i = 0; i < count; ++i)
+	{
+		polytope[i] = simplex.v[i];
+	}
+
+	// touching cores leave a point or a segment, completed into a triangle
+	Vec2 dirs[2] = { Vec2(1.0f, 0.0f), Vec2(-1.0f, 0.0f) };
+	for (size_t attempt = 0; count < 3 && attempt < 4; ++attempt)
+	{
+		Vec2 dir = (count == 2) ? (polytope[1].w - polytope[0].w).GetNormal() * ((attempt & 1) ? -1.0f : 1.0f) : dirs[attempt & 1];
+		SSimplexVertex vertex;
+		vertex.Set(polyA, polyB, GetSupportIndex(polyA, dir * -1.0f, polytope[0].indexA), GetSupportIndex(polyB, dir, polytope[0].indexB));
+
+		bool duplicate = false;
+		for (size_t i = 0; i < count; ++i)
+		{
+			duplicate = duplicate || (vertex.w - polytope[i].w).GetSqrLength() < FLT_EPSILON;
+		}
+		if (!duplicate)
+		{
+			polytope[count++] = vertex;
+		}
+	}
+
+	float area = (count == 3) ? (polytope[1].w - polytope[0].w) ^ (polytope[2].w - polytope[0].w) : 0.0f;
+	if (fabsf(area) < FLT_EPSILON)
+	{
+		// flat Minkowski difference, the cores only touch
+		pointA = polytope[0].wA;
+		pointB = polytope[0].wB;
+		Vec2 offset = polyB.position - polyA.position;
+		normal = (offset.GetSqrLength() > FLT_EPSILON) ? offset.Normalized() * -1.0f : Vec2(0.0f, -1.0f);
+		return 0.0f;
+	}
+
+	// counter clockwise, outward normals are on the right of the edges
+	if (area < 0.0f)
+	{
+		std::swap(polytope[1], polytope[2]);
+	}
+
+	size_t iteration = 0;
+	size_t closestEdge = 0;
+	float closestDist = FLT_MAX;
+	for (;;)
+	{
+		closestDist = FLT_MAX;
+		for (size_t i = 0; i < count; ++i)
+		{
+			size_t next = (i + 1 == count) ? 0 : i + 1;
+			Vec2 edgeNormal = (polytope[i].w - polytope[next].w).GetNormal().Normalized();
+			float dist = edgeNormal | polytope[i].w;
+			if (dist < closestDist)
+			{
+				closestDist = dist;
+				closestEdge = i;
+				normal = edgeNormal;
+			}
+		}
+
+		if (iteration == EPA_MAX_ITERATIONS || count == EPA_MAX_VERTICES)
+		{
+			break;
+		}
+
+		SSimplexVertex vertex;
+		size_t startIndex = closestEdge;
+		vertex.Set(polyA, polyB, GetSupportIndex(polyA, normal * -1.0f, polytope[startIndex].indexA), GetSupportIndex(polyB, normal, polytope[startIndex].indexB));
+		++iteration;
+
+		// the boundary is reached
+		if ((vertex.w | normal) - closestDist < EPA_TOLERANCE)
+		{
+			break;
+		}
+
+		size_t inserted = closestEdge + 1;
+		for (size_t i = count; i > inserted; --i)
+		{
+			polytope[i] = polytope[i - 1];
+		}
+		polytope[inserted] = vertex;
+		++count;
+
+		// the new vertex can be beyond the neighbour edges too, the vertices it hides are removed to keep the polytope convex
+		auto isConvex = [&](size_t i)
+		{
+			const Vec2& previous = polytope[(i + count - 1) % count].w;
+			const Vec2& next = polytope[(i + 1) % count].w;
+			return ((polytope[i].w - previous) ^ (next - polytope[i].w)) > 0.0f;
+		};
+		auto remove = [&](size_t index)
+		{
+			for (size_t i = index; i + 1 < count; ++i)
+			{
+				polytope[i] = polytope[i + 1];
+			}
+			--count;
+			inserted -= (index < inserted) ? 1 : 0;
+		};
+
+		while (count > 3 && !isConvex((inserted + 1) % count))
+		{
+			remove((inserted + 1) % count);
+		}
+		while (count > 3 && !isConvex((inserted + count - 1) % count))
+		{
+			remove((inserted + count - 1) % count);
+		}
+	}
+
+	NARROWPHASE_STAT(gNarrowPhaseStats.epaIterations += iteration);
+
+	const SSimplexVertex& start = polytope[closestEdge];
+	const SSimplexVertex& end = polytope[(closestEdge + 1 == count) ? 0 : closestEdge + 1];
+	float fraction = ClosestSegmentFraction(start.w, end.w, Vec2());
+	pointA = start.wA + (end.wA - start.wA) * fraction;
+	pointB = start.wB + (end.wB - start.wB) * fraction;
+
+	return closestDist;
+}
+
+// Overlapping polygon cores (segments included) penetrate the least along one of their edge normals. With a
+// cache, the exact edge searches climb from the facing edges of the last query instead of running EPA again.
+static float ComputeCoreOverlap(const CPolygon& polyA, const CPolygon& polyB, SSimplexCache& cache, Vec2& normal, Vec2& pointB)
+{
+	size_t edgeA = cache.edgeA;
+	size_t supportB = cache.supportB;
+	float separationA = polyA.FindMaxSeparationEdge(edgeA, polyB, &supportB);
+
+	size_t edgeB = cache.edgeB;
+	size_t supportA = cache.supportA;
+	float separationB = polyB.FindMaxSeparationEdge(edgeB, polyA, &supportA);
+
+	cache.edgeA = (unsigned short)edgeA;
+	cache.edgeB = (unsigned short)edgeB;
+
+	// the deepest vertex of the other core, projected on the edge for B
+	if (separationA >= separationB)
+	{
+		normal = polyA.GetWorldNormal(edgeA);
+		supportB = GetSupportIndex(polyB, normal * -1.0f, supportB);
+		cache.supportB = (unsigned short)supportB;
+		pointB = polyB.GetWorldVertex(supportB);
+		return separationA;
+	}
+
+	Vec2 normalB = polyB.GetWorldNormal(edgeB);
+	supportA = GetSupportIndex(polyA, normalB, supportA);
+	cache.supportA = (unsigned short)supportA;
+	pointB = polyA.GetWorldVertex(supportA) - normalB * separationB;
+	normal = normalB * -1.0f;
+	return separationB;
+}
+
+bool CollideGJK(CPolygon& polyA, CPolygon& polyB, SCollision& collision, float speculativeDistance, SSimplexCache* cache)
+{
+	NARROWPHASE_STAT(gNarrowPhaseStats.pairs++);
+
+	collision.manifoldSize = 0;
+
+	float radius = polyA.GetRadius() + polyB.GetRadius();
+
+	SDistanceOutput output;
+	SSimplex simplex = RunGJK(polyA, polyB, output, cache);
+
+	// from A to B
+	Vec2 normal;
+	float separation;
+	Vec2 pointA = output.pointA;
+	Vec2 pointB = output.pointB;
+	if (output.distance > FLT_EPSILON)
+	{
+		separation = output.distance - radius;
+		if (separation > speculativeDistance)
+		{
+			return false;
+		}
+		normal = (pointB - pointA) / output.distance;
+	}
+	else if (cache && polyA.points.size() >= 2 && polyB.points.size() >= 2)
+	{
+		separation = ComputeCoreOverlap(polyA, polyB, *cache, normal, pointB) - radius;
+	}
+	else
+	{
+		Vec2 boundaryNormal;
+		separation = -RunEPA(polyA, polyB, simplex, boundaryNormal, pointA, pointB) - radius;
+		normal = boundaryNormal * -1.0f;
+	}
+
+	NARROWPHASE_STAT(gNarrowPhaseStats.collisions++);
+
+	// When the separation along an edge of A or B is the GJK / EPA one (within tolerance), the facing edges
+	// are clipped as in the SAT collider. EPA stops at a tolerance, its normal alone isn't precise enough for that.
+	if (polyA.points.size() >= 2 && polyB.points.size() >= 2)
+	{
+		size_t edgeA = cache ? polyA.GetOpposingEdge(normal * -1.0f, cache->edgeA) : polyA.GetOpposingEdge(normal * -1.0f);
+		size_t edgeB = cache ? polyB.GetOpposingEdge(normal, cache->edgeB) : polyB.GetOpposingEdge(normal);
+		Vec2 pointOnA = polyA.GetWorldEdge(edgeA).point;
+		Vec2 pointOnB = polyB.GetWorldEdge(edgeB).point;
+		float separationA, separationB;
+		if (cache)
+		{
+			size_t supportA = cache->supportA;
+			size_t supportB = cache->supportB;
+			separationA = polyB.GetInvSupport(pointOnA, polyA.GetWorldNormal(edgeA), supportB) - radius;
+			separationB = polyA.GetInvSupport(pointOnB, polyB.GetWorldNormal(edgeB), supportA) - radius;
+			cache->edgeA = (unsigned short)edgeA;
+			cache->edgeB = (unsigned short)edgeB;
+			cache->supportA = (unsigned short)supportA;
+			cache->supportB = (unsigned short)supportB;
+		}
+		else
+		{
+			separationA = polyB.GetInvSupport(pointOnA, polyA.GetWorldNormal(edgeA)) - radius;
+			separationB = polyA.GetInvSupport(pointOnB, polyB.GetWorldNormal(edgeB)) - radius;
+		}
+
+		bool referenceOnA = separationA + GJK_FACE_PREFERENCE >= separationB;
+		if (Max(separationA, separationB) >= separation - GJK_FACE_TOLERANCE)
+		{
+			// the incident edge faces the reference one, as the facing edge of the other shape
+			unsigned short incidentEdge = (unsigned short)(referenceOnA ? edgeB : edgeA);
+			AddClippedContacts(polyA, polyB, referenceOnA, referenceOnA ? edgeA : edgeB, speculativeDistance, collision, cache ? &incidentEdge : nullptr);
+			if (collision.manifoldSize > 0)
+			{
+				return true;
+			}
+		}
+	}
+
+	// a vertex or a circle, single point along the GJK / EPA normal
+	SContactInfo& contact = collision.manifold[0];
+	contact.index = 0;
+	contact.pA = &polyA;
+	contact.pB = &polyB;
+	contact.point = pointB - normal * polyB.GetRadius();
+	contact.normal = normal;
+	contact.penetration = -separation;
+	contact.edgeNormalA = normal;
+	contact.edgeNormalB = normal * -1.0f;
+	contact.id = SContactID();
+	contact.id.edgeA = (unsigned short)simplex.v[0].indexA;
+	contact.id.edgeB = (unsigned short)simplex.v[0].indexB;
+	collision.manifoldSize = 1;
+
+	return true;
+}
\ No newline at end of file
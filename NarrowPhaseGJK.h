@@ -0,0 +1,34 @@
+#ifndef _NARROW_PHASE_GJK_H_
+#define _NARROW_PHASE_GJK_H_
+
+#include "Collision.h"
+
+// Vertices of the last GJK simplex of a pair, the next query of the pair starts from them
+struct SSimplexCache
+{
+	unsigned char	count = 0;
+	unsigned short	indexA[3] = { 0, 0, 0 };
+	unsigned short	indexB[3] = { 0, 0, 0 };
+	unsigned short	edgeA = 0; // last facing edges, start of the edge searches of the next query
+	unsigned short	edgeB = 0;
+	unsigned short	supportA = 0; // last support vertices found by the edge searches of the other shape
+	unsigned short	supportB = 0;
+};
+
+// Closest points of the core shapes : polygons, capsule segments and circle centers (radii not included)
+struct SDistanceOutput
+{
+	Vec2	pointA;
+	Vec2	pointB;
+	float	distance; // 0 when the cores overlap
+	size_t	iterations;
+};
+
+void	ComputeDistanceGJK(const CPolygon& polyA, const CPolygon& polyB, SDistanceOutput& output, SSimplexCache* cache = nullptr);
+
+// Alternative to CPolygon::CheckCollision, on the support functions of the shapes : GJK gives the exact
+// separation, EPA the penetration of overlapping cores. Pairs closer than speculativeDistance get
+// contacts with a negative penetration.
+bool	CollideGJK(CPolygon& polyA, CPolygon& polyB, SCollision& collision, float speculativeDistance = 0.0f, SSimplexCache* cache = nullptr);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,185 @@
+#include "PairCache.h"
+
+#include <utility>
+
+#define EMPTY_PAIR_SLOT (0xFFFFFFFFu)
+
+void	CPairCache::Clear()
+{
+	m_slots.clear();
+	m_slotMask = 0;
+	m_pairs.clear();
+	m_addedPairs.clear();
+	m_removedPairs.clear();
+}
+
+void	CPairCache::BeginUpdate()
+{
+	++m_updateIndex;
+	m_addedPairs.clear();
+	m_removedPairs.clear();
+}
+
+void	CPairCache::AddPair(const SPolygonPair& pair)
+{
+	// keep the load factor under 1/2
+	if ((m_pairs.size() + 1) * 2 > m_slots.size())
+	{
+		Rehash(Max(m_slots.size() * 2, (size_t)64));
+	}
+
+	size_t slot = FindSlot(pair.polyA.get(), pair.polyB.get());
+	if (m_slots[slot] != EMPTY_PAIR_SLOT)
+	{
+		m_pairs[m_slots[slot]].lastUpdate = m_updateIndex;
+		return;
+	}
+
+	m_slots[slot] = (unsigned int)m_pairs.size();
+
+	SPairRecord record;
+	record.polyA = pair.polyA;
+	record.polyB = pair.polyB;
+	record.lastUpdate = m_updateIndex;
+	record.contactCount = 0;
+	m_pairs.push_back(record);
+
+	m_addedPairs.push_back(pair);
+}
+
+// remove the pairs not reported since BeginUpdate
+void	CPairCache::EndUpdate()
+{
+	size_t recordIndex = 0;
+	while (recordIndex < m_pairs.size())
+	{
+		SPairRecord& record = m_pairs[recordIndex];
+		if (record.lastUpdate == m_updateIndex)
+		{
+			++recordIndex;
+			continue;
+		}
+
+		m_removedPairs.push_back(SPolygonPair(record.polyA, record.polyB));
+		RemoveSlot(FindRecordSlot((unsigned int)recordIndex));
+
+		// fill the hole with the last record
+		size_t lastIndex = m_pairs.size() - 1;
+		if (recordIndex != lastIndex)
+		{
+			m_slots[FindRecordSlot((unsigned int)lastIndex)] = (unsigned int)recordIndex;
+			m_pairs[recordIndex] = m_pairs[lastIndex];
+		}
+		m_pairs.pop_back();
+	}
+}
+
+SPairRecord*	CPairCache::FindPair(const CPolygon* polyA, const CPolygon* polyB)
+{
+	if (m_slots.empty())
+	{
+		return nullptr;
+	}
+
+	size_t slot = FindSlot(polyA, polyB);
+	return (m_slots[slot] != EMPTY_PAIR_SLOT) ? &m_pairs[m_slots[slot]] : nullptr;
+}
+
+size_t	CPairCache::GetPairCount() const
+{
+	return m_pairs.size();
+}
+
+size_t	CPairCache::GetAddedPairCount() const
+{
+	return m_addedPairs.size();
+}
+
+size_t	CPairCache::GetRemovedPairCount() const
+{
+	return m_removedPairs.size();
+}
+
+// slot holding the pair, or the empty slot where it would be inserted
+size_t	CPairCache::FindSlot(const CPolygon* polyA, const CPolygon* polyB) const
+{
+	size_t slot = GetHash(polyA, polyB) & m_slotMask;
+	while (m_slots[slot] != EMPTY_PAIR_SLOT)
+	{
+		const SPairRecord& record = m_pairs[m_slots[slot]];
+		const CPolygon* recordA = record.polyA.get();
+		const CPolygon* recordB = record.polyB.get();
+		if ((recordA == polyA && recordB == polyB) || (recordA == polyB && recordB == polyA))
+		{
+			break;
+		}
+
+		slot = (slot + 1) & m_slotMask;
+	}
+
+	return slot;
+}
+
+size_t	CPairCache::FindRecordSlot(unsigned int recordIndex) const
+{
+	const SPairRecord& record = m_pairs[recordIndex];
+
+	size_t slot = GetHash(record.polyA.get(), record.polyB.get()) & m_slotMask;
+	while (m_slots[slot] != recordIndex)
+	{
+		slot = (slot + 1) & m_slotMask;
+	}
+
+	return slot;
+}
+
+// backward shift deletion, keeps probe sequences intact without tombstones
+void	CPairCache::RemoveSlot(size_t slot)
+{
+	size_t hole = slot;
+	size_t next = (hole + 1) & m_slotMask;
+	while (m_slots[next] != EMPTY_PAIR_SLOT)
+	{
+		const SPairRecord& record = m_pairs[m_slots[next]];
+		size_t idealSlot = GetHash(record.polyA.get(), record.polyB.get()) & m_slotMask;
+
+		// move back entries whose ideal slot is not between the hole and their slot
+		if (((next - idealSlot) & m_slotMask) >= ((next - hole) & m_slotMask))
+		{
+			m_slots[hole] = m_slots[next];
+			hole = next;
+		}
+
+		next = (next + 1) & m_slotMask;
+	}
+
+	m_slots[hole] = EMPTY_PAIR_SLOT;
+}
+
+void	CPairCache::Rehash(size_t slotCount)
+{
+	m_slots.assign(slotCount, EMPTY_PAIR_SLOT);
+	m_slotMask = slotCount - 1;
+
+	for (size_t recordIndex = 0; recordIndex < m_pairs.size(); ++recordIndex)
+	{
+		const SPairRecord& record = m_pairs[recordIndex];
+		m_slots[FindSlot(record.polyA.get(), record.polyB.get())] = (unsigned int)recordIndex;
+	}
+}
+
+size_t	CPairCache::GetHash(const CPolygon* polyA, const CPolygon* polyB)
+{
+	// order independent
+	unsigned long long keyA = (unsigned long long)(size_t)polyA;
+	unsigned long long keyB = (unsigned long long)(size_t)polyB;
+	if (keyA > keyB)
+	{
+		std::swap(keyA, keyB);
+	}
+
+	unsigned long long hash = keyA * 0x9E3779B97F4A7C15ull;
+	hash ^= keyB + 0x7F4A7C15ull + (hash << 6) + (hash >> 2);
+	hash ^= hash >> 29;
+	return (size_t)hash;
+}
@@ -0,0 +1,93 @@
+#ifndef _PAIR_CACHE_H_
+#define _PAIR_CACHE_H_
+
+#include <vector>
+
+#include "Collision.h"
+#include "NarrowPhaseGJK.h"
+
+// Accumulated impulses of a manifold point, kept for warm starting
+struct SCachedContact
+{
+	unsigned long long	idKey; // SContactID key, seen from (polyA, polyB) of the record
+	float				normalImpulse;
+	float				tangentImpulse;
+};
+
+struct SPairRecord
+{
+	CPolygonPtr		polyA;
+	CPolygonPtr		polyB;
+	size_t			lastUpdate; // last update the broadphase reported the pair in
+
+	size_t			contactCount;
+	SCachedContact	contacts[2];
+
+	SSeparationHint	separationHint; // edgeA is an edge of polyA of the record
+	SSimplexCache	simplexCache; // same, indexA are vertices of polyA
+};
+
+// Overlapping pairs kept across frames in a flat open addressing table (linear probing,
+// backward shift deletion) indexing a dense record array.
+// Each update reports the pairs added and removed since the previous one.
+class CPairCache
+{
+public:
+	void	Clear();
+
+	void	BeginUpdate();
+	void	AddPair(const SPolygonPair& pair);
+	void	EndUpdate();
+
+	SPairRecord*	FindPair(const CPolygon* polyA, const CPolygon* polyB); // nullptr if not cached
+
+	size_t	GetPairCount() const;
+	size_t	GetAddedPairCount() const;
+	size_t	GetRemovedPairCount() const;
+
+	template<typename TFunctor>
+	void	ForEachPair(TFunctor functor)
+	{
+		for (SPairRecord& record : m_pairs)
+		{
+			functor(record);
+		}
+	}
+
+	template<typename TFunctor>
+	void	ForEachAddedPair(TFunctor functor)
+	{
+		for (const SPolygonPair& pair : m_addedPairs)
+		{
+			functor(pair);
+		}
+	}
+
+	template<typename TFunctor>
+	void	ForEachRemovedPair(TFunctor functor)
+	{
+		for (const SPolygonPair& pair : m_removedPairs)
+		{
+			functor(pair);
+		}
+	}
+
+private:
+	size_t	FindSlot(const CPolygon* polyA, const CPolygon* polyB) const;
+	size_t	FindRecordSlot(unsigned int recordIndex) const;
+	void	RemoveSlot(size_t slot);
+	void	Rehash(size_t slotCount);
+
+	static size_t	GetHash(const CPolygon* polyA, const CPolygon* polyB);
+
+	std::vector<unsigned int>	m_slots; // record index, or EMPTY_PAIR_SLOT
+	size_t						m_slotMask = 0;
+
+	std::vector<SPairRecord>	m_pairs;
+	std::vector<SPolygonPair>	m_addedPairs;
+	std::vector<SPolygonPair>	m_removedPairs;
+
+	size_t						m_updateIndex = 0;
+};
+
+#endif
\ No newline at end of file
@@ -1,26 +1,51 @@
 #include "PhysicEngine.h"
 
+#include <float.h>
 #include <iostream>
 #include <string>
 #include "GlobalVariables.h"
 #include "World.h"
 #include "Renderer.h" // for debugging only
-#include "Timer.h"
+#include "Profiler.h"
+#include "TraceRecorder.h"
 
 #include "BroadPhase.h"
 #include "BroadPhaseBrut.h"
 #include "BroadPhaseSweepAndPrune.h"
+#include "BroadPhaseAABBTree.h"
+#include "BroadPhaseGrid.h"
 
 
+// awake dynamic or kinematic body
+static bool IsSimulated(const CPolygon& poly)
+{
+	return poly.IsMoving() && poly.IsAwake();
+}
+
+static bool IsDynamic(const CPolygon& poly)
+{
+	return poly.GetBodyType() == EBodyType::Dynamic;
+}
 
 void	CPhysicEngine::Reset()
 {
 	m_pairsToCheck.clear();
+	m_pairCache.Clear();
 	m_collidingPairs.clear();
+	m_sleepingPairs.clear();
 
 	m_active = true;
 
-	m_broadPhase = new CBroadPhaseSweepAndPrune();
+	delete m_broadPhase;
+	switch (broadPhase)
+	{
+	case EBroadPhase::Brut:				m_broadPhase = new CBroadPhaseBrut(); break;
+	case EBroadPhase::AABBTree:			m_broadPhase = new CBroadPhaseAABBTree(); break;
+	case EBroadPhase::Grid:				m_broadPhase = new CBroadPhaseGrid(); break;
+	default:							m_broadPhase = new CBroadPhaseSweepAndPrune(); break;
+	}
+
+	m_jobs.Start(workerThreads);
 }
 
 void	CPhysicEngine::Activate(bool active)
@@ -28,23 +53,29 @@ void	CPhysicEngine::Activate(bool active)
 	m_active = active;
 }
 
-void	CPhysicEngine::DetectCollisions()
+// Their islands follow on the next step
+void	CPhysicEngine::WakeBodiesInAABB(const AABB& aabb)
 {
-	CTimer timer;
-	timer.Start();
-	CollisionBroadPhase();
-	timer.Stop();
-	if (gVars->bDebug)
+	gVars->pWorld->ForEachPolygon([&](CPolygonPtr poly)
 	{
-		gVars->pRenderer->DisplayText("Collision broadphase duration " + std::to_string(timer.GetDuration() * 1000.0f) + " ms");
-	}
+		if (IsDynamic(*poly) && !poly->IsAwake() && poly->aabb.Intersect(aabb))
+		{
+			poly->SetAwake(true);
+		}
+	});
+}
 
-	timer.Start();
+void	CPhysicEngine::DetectCollisions()
+{
+	CollisionBroadPhase();
 	CollisionNarrowPhase();
-	timer.Stop();
+
 	if (gVars->bDebug)
 	{
-		gVars->pRenderer->DisplayText("Collision narrowphase duration " + std::to_string(timer.GetDuration() * 1000.0f) + " ms, collisions : " + std::to_string(m_collidingPairs.size()));
+		gVars->pRenderer->DisplayText("Pairs to check : " + std::to_string(m_pairsToCheck.size())
+			+ " (+" + std::to_string(m_pairCache.GetAddedPairCount()) + " -" + std::to_string(m_pairCache.GetRemovedPairCount()) + ")"
+			+ ", collisions : " + std::to_string(m_collidingPairs.size())
+			+ ", separating axis hits : " + std::to_string(m_separatingAxisStats.hits) + "/" + std::to_string(m_separatingAxisStats.tests));
 	}
 }
 
@@ -58,67 +89,978 @@ void	CPhysicEngine::Step(float deltaTime)
 		return;
 	}
 
+	PROFILE_ZONE("Physics");
+
 	Vec2 gravity(0, -9.8f);
 	float elasticity = 0.6f;
 
-	gVars->pWorld->ForEachPolygon([&](CPolygonPtr poly)
+	bool subStepped = (stepMode == EStepMode::SoftSubSteps);
+
 	{
-		if (poly->density == 0.0f)
+		PROFILE_ZONE("Integrate");
+
+		// dynamic bodies are integrated by each substep instead
+		gVars->pWorld->ForEachPolygon([&](CPolygonPtr poly)
 		{
-			return;
-		}
+			if (!IsSimulated(*poly) || (subStepped && IsDynamic(*poly)))
+			{
+				return;
+			}
 
-		poly->rotation.Rotate(RAD2DEG(poly->angularVelocity * deltaTime));
-		poly->position += poly->speed * deltaTime;
-		poly->speed += gravity * deltaTime;
-	});
+			poly->rotation.Rotate(RAD2DEG(poly->angularVelocity * deltaTime));
+			poly->position += poly->speed * deltaTime;
+
+			if (poly->GetBodyType() == EBodyType::Dynamic)
+			{
+				poly->speed += gravity * deltaTime;
+			}
+		});
+	}
 
 	DetectCollisions();
 
-	m_contacts.clear();
-	for (SCollision& collision : m_collidingPairs)
 	{
-		CContactConstraint contact(collision, rotationCoeff);
-		contact.InitVelocityConstraint(deltaTime, restVelocityThreshold, restitution);
-		m_contacts.push_back(contact);
+		PROFILE_ZONE("Islands");
+
+		BuildIslands();
+		WakeTouchedIslands();
+		BuildIslandList();
 	}
 
-	for (size_t iteration = 0; iteration < velocityIterations; ++iteration)
 	{
-		for (CContactConstraint& contactConstraint : m_contacts)
+		PROFILE_ZONE("ConstraintInit");
+
+		GatherSolverBodies();
+
+		m_contacts.clear();
+		for (SCollision& collision : m_collidingPairs)
+		{
+			CContactConstraint contact(collision, m_solverBodies, m_solverBodyIndices[collision.polyA->GetIndex()], m_solverBodyIndices[collision.polyB->GetIndex()]);
+			contact.InitVelocityConstraint(m_solverBodies, deltaTime, restVelocityThreshold, restitution);
+			m_contacts.push_back(contact);
+		}
+
+		// once every restitution bias is computed from the integrated velocities
+		m_contactRecords.clear();
+		for (const SCollision& collision : m_collidingPairs)
+		{
+			m_contactRecords.push_back(m_pairCache.FindPair(collision.polyA.get(), collision.polyB.get()));
+		}
+
+		if (warmStarting)
+		{
+			for (size_t i = 0; i < m_contacts.size(); ++i)
+			{
+				if (m_contactRecords[i])
+				{
+					m_contacts[i].LoadImpulses(*m_contactRecords[i]);
+				}
+			}
+		}
+
+		// substeps apply the impulses again each time
+		if (warmStarting && !subStepped)
 		{
-			contactConstraint.SolveVelocityConstraint(staticFriction);
+			for (CContactConstraint& contact : m_contacts)
+			{
+				contact.ApplyImpulses(m_solverBodies);
+			}
 		}
+
+		BuildIslandColors();
 	}
 
-	for (size_t iteration = 0; iteration < positionIterations; ++iteration)
+	if (subStepped)
 	{
-		for (CContactConstraint& contactConstraint : m_contacts)
+		PROFILE_ZONE("SubSteps");
+
+		SolveSubSteps(deltaTime, gravity);
+		ScatterSolverBodies();
+
+		for (size_t i = 0; i < m_contacts.size(); ++i)
 		{
-			contactConstraint.SolvePositionConstraint(slop, positionDampening, positionIterations);
+			if (m_contactRecords[i])
+			{
+				m_contacts[i].CacheImpulses(*m_contactRecords[i]);
+			}
 		}
 	}
+	else
+	{
+		PROFILE_ZONE("VelocitySolve");
+
+		if (contactSolver == EContactSolver::Scalar)
+		{
+			SolveVelocities();
+		}
+		else
+		{
+			SolveVelocitiesSIMD();
+		}
+
+		ScatterSolverBodies();
+
+		for (size_t i = 0; i < m_contacts.size(); ++i)
+		{
+			if (m_contactRecords[i])
+			{
+				m_contacts[i].CacheImpulses(*m_contactRecords[i]);
+			}
+		}
+	}
+
+	if (!subStepped)
+	{
+		PROFILE_ZONE("PositionSolve");
+
+		SolvePositions();
+	}
+
+	UpdateSolverStats();
+
+	if (allowSleeping)
+	{
+		UpdateSleeping(deltaTime);
+	}
 }
 
 void	CPhysicEngine::CollisionBroadPhase()
 {
+	PROFILE_ZONE("BroadPhase");
+
 	m_pairsToCheck.clear();
 	m_broadPhase->GetCollidingPairsToCheck(m_pairsToCheck);
+
+	m_pairCache.BeginUpdate();
+	for (const SPolygonPair& pair : m_pairsToCheck)
+	{
+		m_pairCache.AddPair(pair);
+	}
+	m_pairCache.EndUpdate();
 }
 
 void	CPhysicEngine::CollisionNarrowPhase()
 {
+	PROFILE_ZONE("NarrowPhase");
+
 	m_collidingPairs.clear();
+	m_sleepingPairs.clear();
+	m_separatingAxisStats = SSeparatingAxisStats();
 
 	for (const SPolygonPair& pair : m_pairsToCheck)
 	{
-		SCollision collision;
-		collision.polyA = pair.polyA;
-		collision.polyB = pair.polyB;
+		if (!IsSimulated(*pair.polyA) && !IsSimulated(*pair.polyB))
+		{
+			// kept to link sleeping bodies in islands, tested if the island wakes up
+			if (IsDynamic(*pair.polyA) && IsDynamic(*pair.polyB))
+			{
+				m_sleepingPairs.push_back(pair);
+			}
+			continue;
+		}
+
+		CollidePair(pair);
+	}
+}
+
+// Pair records keep their own polyA, the narrowphase may test them the other way around
+static void SwapSides(SSeparationHint& hint, SSimplexCache& simplexCache)
+{
+	hint = hint.GetSwapped();
+	std::swap(simplexCache.indexA, simplexCache.indexB);
+	std::swap(simplexCache.edgeA, simplexCache.edgeB);
+	std::swap(simplexCache.supportA, simplexCache.supportB);
+}
+
+void	CPhysicEngine::CollidePair(const SPolygonPair& pair)
+{
+	SCollision collision;
+	collision.polyA = pair.polyA;
+	collision.polyB = pair.polyB;
+
+	// the record may hold the pair the other way around
+	SPairRecord* record = m_pairCache.FindPair(pair.polyA.get(), pair.polyB.get());
+	bool swapped = record && (record->polyA != pair.polyA);
+	SSeparationHint hint;
+	SSimplexCache simplexCache;
+	if (record)
+	{
+		hint = record->separationHint;
+		simplexCache = record->simplexCache;
+		if (swapped)
+		{
+			SwapSides(hint, simplexCache);
+		}
+	}
+
+	bool cachedAxis = (hint.separatingAxis != ESeparatingAxis::None);
+	bool colliding = (narrowPhase == ENarrowPhase::GJK)
+		? CollideGJK(*pair.polyA, *pair.polyB, collision, speculativeDistance, &simplexCache)
+		: pair.polyA->CheckCollision(*(pair.polyB), collision, &hint);
+	if (colliding)
+	{
+		m_collidingPairs.push_back(collision);
+	}
+
+	if (cachedAxis && narrowPhase == ENarrowPhase::SAT)
+	{
+		++m_separatingAxisStats.tests;
+		m_separatingAxisStats.hits += hint.separatingAxisHit ? 1 : 0;
+	}
+
+	if (record)
+	{
+		if (swapped)
+		{
+			SwapSides(hint, simplexCache);
+		}
+		record->separationHint = hint;
+		record->simplexCache = simplexCache;
+
+		// impulses of an older contact would be warm started when the pair touches again
+		if (!colliding)
+		{
+			record->contactCount = 0;
+		}
+	}
+}
+
+// Sleeping pairs link sleeping bodies that were in contact when their island fell asleep
+void	CPhysicEngine::BuildIslands()
+{
+	size_t polyCount = gVars->pWorld->GetPolygonCount();
+	m_islandParents.resize(polyCount);
+	for (size_t i = 0; i < polyCount; ++i)
+	{
+		m_islandParents[i] = i;
+	}
+
+	auto link = [&](const CPolygon& polyA, const CPolygon& polyB)
+	{
+		// static and kinematic bodies don't merge islands
+		if (IsDynamic(polyA) && IsDynamic(polyB))
+		{
+			m_islandParents[FindIslandRoot(polyB.GetIndex())] = FindIslandRoot(polyA.GetIndex());
+		}
+	};
+
+	for (const SCollision& collision : m_collidingPairs)
+	{
+		link(*collision.polyA, *collision.polyB);
+	}
+
+	for (const SPolygonPair& pair : m_sleepingPairs)
+	{
+		link(*pair.polyA, *pair.polyB);
+	}
+}
+
+size_t	CPhysicEngine::FindIslandRoot(size_t index)
+{
+	while (m_islandParents[index] != index)
+	{
+		// path halving
+		m_islandParents[index] = m_islandParents[m_islandParents[index]];
+		index = m_islandParents[index];
+	}
+
+	return index;
+}
+
+// Islands holding an awake body, or touched by a simulated one, wake up entirely
+void	CPhysicEngine::WakeTouchedIslands()
+{
+	m_islandAwake.assign(m_islandParents.size(), false);
+
+	gVars->pWorld->ForEachPolygon([&](CPolygonPtr poly)
+	{
+		if (IsDynamic(*poly) && poly->IsAwake())
+		{
+			m_islandAwake[FindIslandRoot(poly->GetIndex())] = true;
+		}
+	});
+
+	// only pairs with a simulated body reach the narrowphase, any collision is a touch
+	for (const SCollision& collision : m_collidingPairs)
+	{
+		if (IsDynamic(*collision.polyA))
+		{
+			m_islandAwake[FindIslandRoot(collision.polyA->GetIndex())] = true;
+		}
+		if (IsDynamic(*collision.polyB))
+		{
+			m_islandAwake[FindIslandRoot(collision.polyB->GetIndex())] = true;
+		}
+	}
+
+	bool wokeUp = false;
+	gVars->pWorld->ForEachPolygon([&](CPolygonPtr poly)
+	{
+		if (IsDynamic(*poly) && !poly->IsAwake() && m_islandAwake[FindIslandRoot(poly->GetIndex())])
+		{
+			poly->SetAwake(true);
+			wokeUp = true;
+		}
+	});
+
+	if (wokeUp)
+	{
+		for (const SPolygonPair& pair : m_sleepingPairs)
+		{
+			if (pair.polyA->IsAwake() || pair.polyB->IsAwake())
+			{
+				CollidePair(pair);
+			}
+		}
+	}
+}
+
+#define INVALID_ISLAND ((size_t)-1)
+
+// Group awake bodies and collisions per island, with a counting sort on the island index
+void	CPhysicEngine::BuildIslandList()
+{
+	m_islands.clear();
+	m_islandIndices.assign(m_islandParents.size(), INVALID_ISLAND);
+
+	size_t bodyCount = 0;
+	gVars->pWorld->ForEachPolygon([&](CPolygonPtr poly)
+	{
+		if (!IsDynamic(*poly) || !poly->IsAwake())
+		{
+			return;
+		}
+
+		size_t& islandIndex = m_islandIndices[FindIslandRoot(poly->GetIndex())];
+		if (islandIndex == INVALID_ISLAND)
+		{
+			islandIndex = m_islands.size();
+			m_islands.push_back(SIsland());
+			m_islands.back().bodyCount = 0;
+			m_islands.back().contactCount = 0;
+			m_islands.back().velocityIterations = 0;
+			m_islands.back().velocityResidual = 0.0f;
+			m_islands.back().positionIterations = 0;
+			m_islands.back().positionResidual = 0.0f;
+			m_islands.back().firstColor = 0;
+			m_islands.back().colorCount = 0;
+		}
+
+		++m_islands[islandIndex].bodyCount;
+		++bodyCount;
+	});
+
+	// any collision holds an awake dynamic body once touched islands are woken up
+	auto getCollisionIsland = [&](const SCollision& collision)
+	{
+		const CPolygon& dynamicPoly = IsDynamic(*collision.polyA) ? *collision.polyA : *collision.polyB;
+		return m_islandIndices[FindIslandRoot(dynamicPoly.GetIndex())];
+	};
+
+	for (const SCollision& collision : m_collidingPairs)
+	{
+		++m_islands[getCollisionIsland(collision)].contactCount;
+	}
+
+	size_t firstBody = 0;
+	size_t firstContact = 0;
+	for (SIsland& island : m_islands)
+	{
+		island.firstBody = firstBody;
+		island.firstContact = firstContact;
+		firstBody += island.bodyCount;
+		firstContact += island.contactCount;
+
+		// used as insertion cursors below
+		island.bodyCount = 0;
+		island.contactCount = 0;
+	}
+
+	m_islandBodies.resize(bodyCount);
+	gVars->pWorld->ForEachPolygon([&](CPolygonPtr poly)
+	{
+		if (IsDynamic(*poly) && poly->IsAwake())
+		{
+			SIsland& island = m_islands[m_islandIndices[FindIslandRoot(poly->GetIndex())]];
+			m_islandBodies[island.firstBody + island.bodyCount++] = poly;
+		}
+	});
+
+	m_sortedCollisions.resize(m_collidingPairs.size());
+	for (const SCollision& collision : m_collidingPairs)
+	{
+		SIsland& island = m_islands[getCollisionIsland(collision)];
+		m_sortedCollisions[island.firstContact + island.contactCount++] = collision;
+	}
+	m_collidingPairs.swap(m_sortedCollisions);
+}
+
+void	CPhysicEngine::UpdateSleeping(float deltaTime)
+{
+	PROFILE_ZONE("Sleeping");
+
+	float linearTolSqr = linearSleepTolerance * linearSleepTolerance;
+	size_t awakeCount = 0;
+
+	for (const SIsland& island : m_islands)
+	{
+		float islandSleepTime = FLT_MAX;
+
+		ForEachIslandBody(island, [&](CPolygonPtr poly)
+		{
+			if (poly->speed.GetSqrLength() > linearTolSqr || fabsf(poly->angularVelocity) > angularSleepTolerance)
+			{
+				poly->sleepTime = 0.0f;
+			}
+			else
+			{
+				poly->sleepTime += deltaTime;
+			}
+
+			islandSleepTime = Min(islandSleepTime, poly->sleepTime);
+		});
+
+		// moving kinematic bodies keep what they touch awake
+		for (size_t i = island.firstContact; i < island.firstContact + island.contactCount; ++i)
+		{
+			const SCollision& collision = m_collidingPairs[i];
+			const CPolygon& otherPoly = IsDynamic(*collision.polyA) ? *collision.polyB : *collision.polyA;
+
+			if (otherPoly.GetBodyType() == EBodyType::Kinematic && (otherPoly.speed.GetSqrLength() > 0.0f || otherPoly.angularVelocity != 0.0f))
+			{
+				islandSleepTime = 0.0f;
+			}
+		}
+
+		if (islandSleepTime >= timeToSleep)
+		{
+			ForEachIslandBody(island, [&](CPolygonPtr poly)
+			{
+				poly->SetAwake(false);
+			});
+		}
+		else
+		{
+			awakeCount += island.bodyCount;
+		}
+	}
+
+	if (gVars->bDebug)
+	{
+		gVars->pRenderer->DisplayText("Awake bodies : " + std::to_string(awakeCount) + ", islands : " + std::to_string(m_islands.size()));
+	}
+}
+
+const SSolverStats&	CPhysicEngine::GetSolverStats() const
+{
+	return m_solverStats;
+}
+
+const SSeparatingAxisStats&	CPhysicEngine::GetSeparatingAxisStats() const
+{
+	return m_separatingAxisStats;
+}
+
+void	CPhysicEngine::UpdateSolverStats()
+{
+	m_solverStats = SSolverStats();
+	m_solverStats.islandCount = m_islands.size();
+
+	for (const SIsland& island : m_islands)
+	{
+		m_solverStats.velocityIterations += island.velocityIterations;
+		m_solverStats.maxVelocityIterations = Max(m_solverStats.maxVelocityIterations, island.velocityIterations);
+		m_solverStats.maxVelocityResidual = Max(m_solverStats.maxVelocityResidual, island.velocityResidual);
+		m_solverStats.positionIterations += island.positionIterations;
+		m_solverStats.maxPositionIterations = Max(m_solverStats.maxPositionIterations, island.positionIterations);
+		m_solverStats.maxPositionResidual = Max(m_solverStats.maxPositionResidual, island.positionResidual);
+
+		if (island.velocityResidual > velocityTolerance || island.positionResidual > positionTolerance)
+		{
+			++m_solverStats.unconvergedIslands;
+		}
+	}
+
+	if (gVars->bDebug)
+	{
+		gVars->pRenderer->DisplayText("Velocity iterations : " + std::to_string(m_solverStats.velocityIterations)
+			+ " (max " + std::to_string(m_solverStats.maxVelocityIterations) + ", residual " + std::to_string(m_solverStats.maxVelocityResidual) + ")"
+			+ ", position iterations : " + std::to_string(m_solverStats.positionIterations)
+			+ " (max " + std::to_string(m_solverStats.maxPositionIterations) + ", residual " + std::to_string(m_solverStats.maxPositionResidual) + ")"
+			+ ", unconverged islands : " + std::to_string(m_solverStats.unconvergedIslands) + "/" + std::to_string(m_solverStats.islandCount));
+	}
+}
+
+size_t	CPhysicEngine::GetIslandCount() const
+{
+	return m_islands.size();
+}
+
+const SIsland&	CPhysicEngine::GetIsland(size_t index) const
+{
+	return m_islands[index];
+}
+
+#define INVALID_SOLVER_BODY ((unsigned int)-1)
+
+// Awake dynamic bodies first, island by island, then the static and kinematic bodies they touch
+void	CPhysicEngine::GatherSolverBodies()
+{
+	m_solverBodies.clear();
+	m_solverBodyPolygons.clear();
+	m_solverBodyIndices.assign(gVars->pWorld->GetPolygonCount(), INVALID_SOLVER_BODY);
+
+	auto addBody = [&](const CPolygonPtr& poly)
+	{
+		unsigned int& index = m_solverBodyIndices[poly->GetIndex()];
+		if (index != INVALID_SOLVER_BODY)
+		{
+			return;
+		}
+
+		index = (unsigned int)m_solverBodies.size();
+
+		SSolverBody body;
+		body.speed = poly->speed;
+		body.angularVelocity = poly->angularVelocity;
+		body.invMass = IsDynamic(*poly) ? 1.0f / poly->GetMass() : 0.0f;
+		body.invTensor = IsDynamic(*poly) ? rotationCoeff / poly->GetInertiaTensor() : 0.0f;
+		m_solverBodies.push_back(body);
+		m_solverBodyPolygons.push_back(poly.get());
+	};
+
+	for (const CPolygonPtr& poly : m_islandBodies)
+	{
+		addBody(poly);
+	}
+
+	for (const SCollision& collision : m_collidingPairs)
+	{
+		addBody(collision.polyA);
+		addBody(collision.polyB);
+	}
+}
+
+void	CPhysicEngine::ScatterSolverBodies()
+{
+	for (size_t i = 0; i < m_solverBodies.size(); ++i)
+	{
+		if (m_solverBodies[i].invMass > 0.0f)
+		{
+			m_solverBodyPolygons[i]->speed = m_solverBodies[i].speed;
+			m_solverBodyPolygons[i]->angularVelocity = m_solverBodies[i].angularVelocity;
+		}
+	}
+}
+
+#define MAX_ISLAND_COLORS 64
+#define COLOR_CHUNK_CONTACTS 32 // contacts per task when a color is solved concurrently
+
+// Greedy coloring in contact order, static and kinematic bodies are never written and can be shared.
+// Contacts finding no free color get a color of their own.
+void	CPhysicEngine::BuildIslandColors()
+{
+	m_colors.clear();
+	m_colorContacts.clear();
+	m_uncoloredIslands.clear();
+	m_bodyColors.resize(gVars->pWorld->GetPolygonCount());
+
+	for (size_t islandIndex = 0; islandIndex < m_islands.size(); ++islandIndex)
+	{
+		SIsland& island = m_islands[islandIndex];
+		island.firstColor = m_colors.size();
+		island.colorCount = 0;
+
+		if (island.contactCount < colorIslandContacts)
+		{
+			m_uncoloredIslands.push_back(islandIndex);
+			continue;
+		}
+
+		ForEachIslandBody(island, [&](CPolygonPtr poly)
+		{
+			m_bodyColors[poly->GetIndex()] = 0;
+		});
+
+		size_t colorCounts[MAX_ISLAND_COLORS] = {};
+		m_contactColorIndices.resize(island.contactCount);
+
+		for (size_t i = 0; i < island.contactCount; ++i)
+		{
+			const SCollision& collision = m_collidingPairs[island.firstContact + i];
+			bool dynamicA = IsDynamic(*collision.polyA);
+			bool dynamicB = IsDynamic(*collision.polyB);
+
+			unsigned long long usedColors = (dynamicA ? m_bodyColors[collision.polyA->GetIndex()] : 0) | (dynamicB ? m_bodyColors[collision.polyB->GetIndex()] : 0);
+			size_t color = 0;
+			while (color < MAX_ISLAND_COLORS && (usedColors & (1ull << color)))
+			{
+				++color;
+			}
+
+			if (color < MAX_ISLAND_COLORS)
+			{
+				if (dynamicA)
+				{
+					m_bodyColors[collision.polyA->GetIndex()] |= (1ull << color);
+				}
+				if (dynamicB)
+				{
+					m_bodyColors[collision.polyB->GetIndex()] |= (1ull << color);
+				}
+				++colorCounts[color];
+			}
+
+			m_contactColorIndices[i] = color;
+		}
+
+		// a contact only gets a color once the lower ones are taken, used colors come first
+		size_t first = m_colorContacts.size();
+		size_t colorCursors[MAX_ISLAND_COLORS];
+		for (size_t color = 0; color < MAX_ISLAND_COLORS && colorCounts[color] > 0; ++color)
+		{
+			colorCursors[color] = first;
+			m_colors.push_back({ first, colorCounts[color] });
+			first += colorCounts[color];
+		}
+
+		m_colorContacts.resize(m_colorContacts.size() + island.contactCount);
+		for (size_t i = 0; i < island.contactCount; ++i)
+		{
+			size_t color = m_contactColorIndices[i];
+			if (color < MAX_ISLAND_COLORS)
+			{
+				m_colorContacts[colorCursors[color]++] = island.firstContact + i;
+			}
+			else
+			{
+				m_colorContacts[first] = island.firstContact + i;
+				m_colors.push_back({ first, 1 });
+				++first;
+			}
+		}
+
+		island.colorCount = m_colors.size() - island.firstColor;
+	}
+}
+
+// Runs functor(chunk, firstContact, lastContact) over the contacts of a color, split in chunks
+template<typename TFunctor>
+static void ParallelForColor(CJobSystem& jobs, const SContactColor& color, TFunctor functor)
+{
+	size_t chunkCount = (color.count + COLOR_CHUNK_CONTACTS - 1) / COLOR_CHUNK_CONTACTS;
+	jobs.ParallelFor(chunkCount, [&](size_t chunk)
+	{
+		size_t first = color.first + chunk * COLOR_CHUNK_CONTACTS;
+		functor(chunk, first, Min(first + COLOR_CHUNK_CONTACTS, color.first + color.count));
+	});
+}
+
+// Small islands are spread over the threads, big ones are solved one after the other with
+// their colors split over the threads. The split only depends on the contact counts.
+void	CPhysicEngine::SolveVelocities()
+{
+	m_jobs.ParallelFor(m_uncoloredIslands.size(), [&](size_t i)
+	{
+		TRACE_ZONE("IslandVelocities");
+		SolveIslandVelocities(m_islands[m_uncoloredIslands[i]]);
+	});
+
+	for (SIsland& island : m_islands)
+	{
+		if (island.colorCount > 0)
+		{
+			SolveColoredIslandVelocities(island);
+		}
+	}
+}
+
+// Iterate until no contact of the island changes velocities more than the tolerance, within the iteration bounds
+void	CPhysicEngine::SolveIslandVelocities(SIsland& island)
+{
+	island.velocityIterations = 0;
+	while (island.velocityIterations < velocityIterations)
+	{
+		float maxVelocityChange = 0.0f;
+		for (size_t i = island.firstContact; i < island.firstContact + island.contactCount; ++i)
+		{
+			maxVelocityChange = Max(maxVelocityChange, m_contacts[i].SolveVelocityConstraint(m_solverBodies, staticFriction));
+		}
+
+		++island.velocityIterations;
+		island.velocityResidual = maxVelocityChange;
+
+		if (maxVelocityChange <= velocityTolerance && island.velocityIterations >= minVelocityIterations)
+		{
+			break;
+		}
+	}
+}
+
+// Same as SolveIslandVelocities, one color after the other
+void	CPhysicEngine::SolveColoredIslandVelocities(SIsland& island)
+{
+	island.velocityIterations = 0;
+	while (island.velocityIterations < velocityIterations)
+	{
+		float maxVelocityChange = 0.0f;
+		for (size_t colorIndex = island.firstColor; colorIndex < island.firstColor + island.colorCount; ++colorIndex)
+		{
+			const SContactColor& color = m_colors[colorIndex];
+			m_colorChunkResults.assign((color.count + COLOR_CHUNK_CONTACTS - 1) / COLOR_CHUNK_CONTACTS, 0.0f);
+
+			ParallelForColor(m_jobs, color, [&](size_t chunk, size_t first, size_t last)
+			{
+				TRACE_ZONE("ColorVelocities");
+
+				float chunkVelocityChange = 0.0f;
+				for (size_t i = first; i < last; ++i)
+				{
+					chunkVelocityChange = Max(chunkVelocityChange, m_contacts[m_colorContacts[i]].SolveVelocityConstraint(m_solverBodies, staticFriction));
+				}
+				m_colorChunkResults[chunk] = chunkVelocityChange;
+			});
+
+			for (float chunkVelocityChange : m_colorChunkResults)
+			{
+				maxVelocityChange = Max(maxVelocityChange, chunkVelocityChange);
+			}
+		}
+
+		++island.velocityIterations;
+		island.velocityResidual = maxVelocityChange;
+
+		if (maxVelocityChange <= velocityTolerance && island.velocityIterations >= minVelocityIterations)
+		{
+			break;
+		}
+	}
+}
+
+// All islands are colored and batched together, they share the iteration count
+void	CPhysicEngine::SolveVelocitiesSIMD()
+{
+	size_t laneCount = (contactSolver == EContactSolver::SIMD8) ? 8 : 4;
+	m_contactSolverSIMD.Prepare(m_contacts, m_solverBodies, laneCount, staticFriction);
+	float residual = 0.0f;
+	size_t iterations = m_contactSolverSIMD.SolveVelocities(minVelocityIterations, velocityIterations, velocityTolerance, residual);
+	m_contactSolverSIMD.Finish(m_contacts, m_solverBodies);
+
+	for (SIsland& island : m_islands)
+	{
+		island.velocityIterations = iterations;
+		island.velocityResidual = residual;
+	}
+
+	if (gVars->bDebug)
+	{
+		gVars->pRenderer->DisplayText("Solver colors : " + std::to_string(m_contactSolverSIMD.GetColorCount())
+			+ ", batches : " + std::to_string(m_contactSolverSIMD.GetBatchCount()));
+	}
+}
+
+// Soft step : the manifolds of the start of the step are kept for every substep, only their
+// separations follow the bodies. Islands are independent, their substeps run separately.
+void	CPhysicEngine::SolveSubSteps(float deltaTime, const Vec2& gravity)
+{
+	float subStep = deltaTime / (float)Max(subSteps, (size_t)1);
+
+	SSoftStep step;
+	step.contactSoftness = MakeSoftness(contactHertz, contactDampingRatio, subStep);
+	step.staticSoftness = MakeSoftness(2.0f * contactHertz, contactDampingRatio, subStep);
+	step.invSubStep = 1.0f / subStep;
+	step.maxPushVelocity = contactPushVelocity;
+	step.slop = slop;
+	step.staticFriction = staticFriction;
+
+	m_jobs.ParallelFor(m_uncoloredIslands.size(), [&](size_t i)
+	{
+		TRACE_ZONE("IslandSubSteps");
+		SolveIslandSubSteps(m_islands[m_uncoloredIslands[i]], step, gravity, subStep);
+	});
+
+	for (SIsland& island : m_islands)
+	{
+		if (island.colorCount > 0)
+		{
+			SolveColoredIslandSubSteps(island, step, gravity, subStep);
+		}
+
+		island.velocityIterations = Max(subSteps, (size_t)1);
+		island.velocityResidual = 0.0f;
+		island.positionIterations = 0;
+		island.positionResidual = 0.0f;
+	}
+}
+
+// The bodies of an island are contiguous in the solver bodies, in the island order
+void	CPhysicEngine::SolveIslandSubSteps(const SIsland& island, const SSoftStep& step, const Vec2& gravity, float subStep)
+{
+	size_t firstBody = island.firstBody;
+	size_t lastBody = island.firstBody + island.bodyCount;
+	size_t firstContact = island.firstContact;
+	size_t lastContact = island.firstContact + island.contactCount;
+
+	for (size_t subStepIndex = 0; subStepIndex < Max(subSteps, (size_t)1); ++subStepIndex)
+	{
+		IntegrateSubStepVelocities(firstBody, lastBody, gravity, subStep);
+
+		for (size_t i = firstContact; i < lastContact && warmStarting; ++i)
+		{
+			m_contacts[i].ApplyImpulses(m_solverBodies);
+		}
+		for (size_t i = firstContact; i < lastContact; ++i)
+		{
+			m_contacts[i].SolveSoftConstraint(m_solverBodies, step, true);
+		}
+
+		IntegrateSubStepPositions(firstBody, lastBody, subStep);
+
+		for (size_t i = firstContact; i < lastContact; ++i)
+		{
+			m_contacts[i].SolveSoftConstraint(m_solverBodies, step, false);
+		}
+	}
+
+	for (size_t i = firstContact; i < lastContact; ++i)
+	{
+		m_contacts[i].ApplyRestitution(m_solverBodies);
+	}
+}
+
+// Same as SolveIslandSubSteps, each pass goes one color after the other
+void	CPhysicEngine::SolveColoredIslandSubSteps(const SIsland& island, const SSoftStep& step, const Vec2& gravity, float subStep)
+{
+	auto solveColors = [&](std::function<void(CContactConstraint&)> solve)
+	{
+		for (size_t colorIndex = island.firstColor; colorIndex < island.firstColor + island.colorCount; ++colorIndex)
+		{
+			ParallelForColor(m_jobs, m_colors[colorIndex], [&](size_t, size_t first, size_t last)
+			{
+				TRACE_ZONE("ColorSubStep");
+
+				for (size_t i = first; i < last; ++i)
+				{
+					solve(m_contacts[m_colorContacts[i]]);
+				}
+			});
+		}
+	};
+
+	size_t firstBody = island.firstBody;
+	size_t lastBody = island.firstBody + island.bodyCount;
+
+	for (size_t subStepIndex = 0; subStepIndex < Max(subSteps, (size_t)1); ++subStepIndex)
+	{
+		IntegrateSubStepVelocities(firstBody, lastBody, gravity, subStep);
+
+		if (warmStarting)
+		{
+			solveColors([&](CContactConstraint& contact) { contact.ApplyImpulses(m_solverBodies); });
+		}
+		solveColors([&](CContactConstraint& contact) { contact.SolveSoftConstraint(m_solverBodies, step, true); });
+
+		IntegrateSubStepPositions(firstBody, lastBody, subStep);
+
+		solveColors([&](CContactConstraint& contact) { contact.SolveSoftConstraint(m_solverBodies, step, false); });
+	}
+
+	solveColors([&](CContactConstraint& contact) { contact.ApplyRestitution(m_solverBodies); });
+}
+
+void	CPhysicEngine::IntegrateSubStepVelocities(size_t firstBody, size_t lastBody, const Vec2& gravity, float subStep)
+{
+	for (size_t i = firstBody; i < lastBody; ++i)
+	{
+		m_solverBodies[i].speed += gravity * subStep;
+	}
+}
+
+void	CPhysicEngine::IntegrateSubStepPositions(size_t firstBody, size_t lastBody, float subStep)
+{
+	for (size_t i = firstBody; i < lastBody; ++i)
+	{
+		CPolygon* poly = m_solverBodyPolygons[i];
+		poly->rotation.Rotate(RAD2DEG(m_solverBodies[i].angularVelocity * subStep));
+		poly->position += m_solverBodies[i].speed * subStep;
+	}
+}
+
+void	CPhysicEngine::SolvePositions()
+{
+	m_jobs.ParallelFor(m_uncoloredIslands.size(), [&](size_t i)
+	{
+		TRACE_ZONE("IslandPositions");
+		SolveIslandPositions(m_islands[m_uncoloredIslands[i]]);
+	});
+
+	for (SIsland& island : m_islands)
+	{
+		if (island.colorCount > 0)
+		{
+			SolveColoredIslandPositions(island);
+		}
+	}
+}
+
+// Positions are corrected directly, velocities are left untouched. Stops once no contact
+// of the island penetrates more than the tolerance, within the iteration bounds.
+void	CPhysicEngine::SolveIslandPositions(SIsland& island)
+{
+	island.positionIterations = 0;
+	while (island.positionIterations < positionIterations)
+	{
+		float minSeparation = 0.0f;
+		for (size_t i = island.firstContact; i < island.firstContact + island.contactCount; ++i)
+		{
+			minSeparation = Min(minSeparation, m_contacts[i].SolvePositionConstraint(slop, positionCorrection, maxPositionCorrection));
+		}
+
+		++island.positionIterations;
+		island.positionResidual = -minSeparation;
+
+		if (minSeparation >= -positionTolerance && island.positionIterations >= minPositionIterations)
+		{
+			break;
+		}
+	}
+}
+
+void	CPhysicEngine::SolveColoredIslandPositions(SIsland& island)
+{
+	island.positionIterations = 0;
+	while (island.positionIterations < positionIterations)
+	{
+		float minSeparation = 0.0f;
+		for (size_t colorIndex = island.firstColor; colorIndex < island.firstColor + island.colorCount; ++colorIndex)
+		{
+			const SContactColor& color = m_colors[colorIndex];
+			m_colorChunkResults.assign((color.count + COLOR_CHUNK_CONTACTS - 1) / COLOR_CHUNK_CONTACTS, 0.0f);
+
+			ParallelForColor(m_jobs, color, [&](size_t chunk, size_t first, size_t last)
+			{
+				TRACE_ZONE("ColorPositions");
+
+				float chunkSeparation = 0.0f;
+				for (size_t i = first; i < last; ++i)
+				{
+					chunkSeparation = Min(chunkSeparation, m_contacts[m_colorContacts[i]].SolvePositionConstraint(slop, positionCorrection, maxPositionCorrection));
+				}
+				m_colorChunkResults[chunk] = chunkSeparation;
+			});
+
+			for (float chunkSeparation : m_colorChunkResults)
+			{
+				minSeparation = Min(minSeparation, chunkSeparation);
+			}
+		}
+
+		++island.positionIterations;
+		island.positionResidual = -minSeparation;
 
-		if (pair.polyA->CheckCollision(*(pair.polyB), collision))
+		if (minSeparation >= -positionTolerance && island.positionIterations >= minPositionIterations)
 		{
-			m_collidingPairs.push_back(collision);
+			break;
 		}
 	}
 }
\ No newline at end of file
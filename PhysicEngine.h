@@ -7,9 +7,82 @@
 #include "Polygon.h"
 #include "Collision.h"
 #include "ContactConstraint.h"
+#include "PairCache.h"
+#include "ContactSolverSIMD.h"
+#include "JobSystem.h"
 
 class IBroadPhase;
 
+enum class EBroadPhase
+{
+	Brut,
+	SweepAndPrune,
+	AABBTree,
+	Grid,
+};
+
+enum class EContactSolver
+{
+	Scalar,
+	SIMD4, // SSE batches
+	SIMD8, // AVX batches
+};
+
+enum class ENarrowPhase
+{
+	SAT, // CPolygon::CheckCollision, separating axes with hinted edges
+	GJK, // CollideGJK, GJK distance and EPA penetration from cached simplices, with speculative contacts
+};
+
+enum class EStepMode
+{
+	PGS,			// velocity iterations on the whole step, then position iterations
+	SoftSubSteps,	// TGS-style, each substep integrates, does one soft contact pass and one relax pass
+};
+
+// Dynamic bodies linked by contacts, static and kinematic bodies don't merge islands
+struct SIsland
+{
+	size_t	firstBody;
+	size_t	bodyCount;
+	size_t	firstContact; // contacts of an island are contiguous, in ForEachCollision order
+	size_t	contactCount;
+	size_t	velocityIterations; // run during the last step, fewer than the engine param on early exit
+	float	velocityResidual; // largest contact velocity change of the last velocity iteration
+	size_t	positionIterations;
+	float	positionResidual; // deepest penetration seen by the last position iteration
+	size_t	firstColor;
+	size_t	colorCount; // 0 for islands solved in one go
+};
+
+// Convergence of the last step, over the awake islands
+struct SSolverStats
+{
+	size_t	islandCount = 0;
+	size_t	velocityIterations = 0; // summed over the islands
+	size_t	maxVelocityIterations = 0;
+	float	maxVelocityResidual = 0.0f;
+	size_t	positionIterations = 0;
+	size_t	maxPositionIterations = 0;
+	float	maxPositionResidual = 0.0f;
+	size_t	unconvergedIslands = 0; // stopped by the max iteration counts
+};
+
+// Separating axes cached in the pair records by the SAT narrowphase, over the last step. Circles against
+// circles or capsules have no edge to cache, these pairs are never counted.
+struct SSeparatingAxisStats
+{
+	size_t	tests = 0; // pairs separated on their previous test
+	size_t	hits = 0; // pairs still separated by the same edge, their other edges were skipped
+};
+
+// Contacts of a color share no dynamic body, they are solved concurrently
+struct SContactColor
+{
+	size_t	first; // in the color contact list
+	size_t	count;
+};
+
 class CPhysicEngine
 {
 public:
@@ -18,16 +91,48 @@ public:
 	float	restitution = 0.5f;
 	float	staticFriction = 0.5f;
 	float	slop = 0.01f;
-	float	positionDampening = 0.5f;
-	size_t	velocityIterations = 100;
-	size_t	positionIterations = 5;
+	float	positionCorrection = 0.2f; // fraction of the penetration beyond slop removed per position iteration
+	float	maxPositionCorrection = 0.2f;
+	size_t	minVelocityIterations = 1;
+	// The tolerance ends the loop early for resting islands. Islands with fresh impacts or tall stacks normally
+	// run to the max count instead, their stability comes from warm starting, not from converging in one step.
+	size_t	velocityIterations = 10; // max
+	float	velocityTolerance = 1e-4f; // an island stops iterating once no contact velocity changes more than this
+	bool	warmStarting = true; // start from the impulses of the previous step
+	EContactSolver	contactSolver = EContactSolver::Scalar; // SIMD solvers run every island together
+	size_t	minPositionIterations = 1;
+	size_t	positionIterations = 5; // max
+	float	positionTolerance = 0.03f; // an island stops iterating once no contact penetrates more than this
 	float	rotationCoeff = 1.0f;
 
+	// sub-stepped soft solver, the scalar solver is always used and the position params are ignored
+	EStepMode	stepMode = EStepMode::PGS;
+	size_t	subSteps = 4;
+	float	contactHertz = 60.0f; // stiffness of the contact springs, twice as stiff against static bodies
+	float	contactDampingRatio = 10.0f;
+	float	contactPushVelocity = 3.0f; // max speed at which penetrating bodies are pushed apart
+	EBroadPhase	broadPhase = EBroadPhase::SweepAndPrune; // applied on Reset
+	ENarrowPhase	narrowPhase = ENarrowPhase::SAT;
+	float	speculativeDistance = 0.04f; // GJK narrowphase only, pairs closer than this get contacts before touching
+
+	// multithreading, results don't depend on the thread count
+	size_t	workerThreads = 0; // besides the main thread, applied on Reset
+	size_t	colorIslandContacts = 128; // bigger islands are split in colors, smaller ones are solved one per thread
+
+	// sleeping
+	bool	allowSleeping = true;
+	float	linearSleepTolerance = 0.05f;
+	float	angularSleepTolerance = DEG2RAD(2.0f);
+	float	timeToSleep = 0.5f; // seconds a whole island must stay under the tolerances
+
 
 public:
 	void	Reset();
 	void	Activate(bool active);
 
+	// Sleeping bodies only wake up from simulated ones, static bodies moved by hand wake them with this
+	void	WakeBodiesInAABB(const AABB& aabb);
+
 	void	DetectCollisions();
 
 	void	Step(float deltaTime);
@@ -41,19 +146,113 @@ public:
 		}
 	}
 
+	// Broadphase pairs that started / stopped overlapping during the last step
+	template<typename TFunctor>
+	void	ForEachAddedPair(TFunctor functor)
+	{
+		m_pairCache.ForEachAddedPair(functor);
+	}
+
+	template<typename TFunctor>
+	void	ForEachRemovedPair(TFunctor functor)
+	{
+		m_pairCache.ForEachRemovedPair(functor);
+	}
+
+	const SSolverStats&	GetSolverStats() const;
+	const SSeparatingAxisStats&	GetSeparatingAxisStats() const;
+
+	// Islands of the last step, awake bodies only
+	size_t			GetIslandCount() const;
+	const SIsland&	GetIsland(size_t index) const;
+
+	template<typename TFunctor>
+	void	ForEachIsland(TFunctor functor)
+	{
+		for (const SIsland& island : m_islands)
+		{
+			functor(island);
+		}
+	}
+
+	template<typename TFunctor>
+	void	ForEachIslandBody(const SIsland& island, TFunctor functor)
+	{
+		for (size_t i = island.firstBody; i < island.firstBody + island.bodyCount; ++i)
+		{
+			functor(m_islandBodies[i]);
+		}
+	}
+
 private:
 	void							CollisionBroadPhase();
 	void							CollisionNarrowPhase();
+	void							CollidePair(const SPolygonPair& pair);
+
+	// Islands, union-find on polygon indices
+	void							BuildIslands();
+	size_t							FindIslandRoot(size_t index);
+	void							WakeTouchedIslands();
+	void							BuildIslandList();
+	void							UpdateSleeping(float deltaTime);
+
+	// Dense copy of the bodies touched by the solver
+	void							GatherSolverBodies();
+	void							ScatterSolverBodies();
+
+	// Constraint graph coloring of big islands
+	void							BuildIslandColors();
+
+	void							SolveVelocities();
+	void							SolveIslandVelocities(SIsland& island);
+	void							SolveColoredIslandVelocities(SIsland& island);
+	void							SolveVelocitiesSIMD();
+	void							SolveSubSteps(float deltaTime, const Vec2& gravity);
+	void							SolveIslandSubSteps(const SIsland& island, const SSoftStep& step, const Vec2& gravity, float subStep);
+	void							SolveColoredIslandSubSteps(const SIsland& island, const SSoftStep& step, const Vec2& gravity, float subStep);
+	void							IntegrateSubStepVelocities(size_t firstBody, size_t lastBody, const Vec2& gravity, float subStep);
+	void							IntegrateSubStepPositions(size_t firstBody, size_t lastBody, float subStep);
+	void							SolvePositions();
+	void							UpdateSolverStats();
+	void							SolveIslandPositions(SIsland& island);
+	void							SolveColoredIslandPositions(SIsland& island);
 
 	bool							m_active = true;
 
 	// Collision detection
-	IBroadPhase*					m_broadPhase;
+	IBroadPhase*					m_broadPhase = nullptr;
 	std::vector<SPolygonPair>		m_pairsToCheck;
+	CPairCache						m_pairCache;
 	std::vector<SCollision>			m_collidingPairs;
+	std::vector<SPolygonPair>		m_sleepingPairs; // skipped by the narrowphase, both bodies asleep
+	SSeparatingAxisStats			m_separatingAxisStats;
+
+	// Islands
+	std::vector<size_t>				m_islandParents;
+	std::vector<bool>				m_islandAwake;
+	std::vector<size_t>				m_islandIndices; // island of each union-find root
+	std::vector<SIsland>			m_islands;
+	std::vector<CPolygonPtr>		m_islandBodies;
+	std::vector<SCollision>			m_sortedCollisions;
+	std::vector<size_t>				m_uncoloredIslands;
+
+	// Colors
+	std::vector<unsigned long long>	m_bodyColors; // colors used by each polygon, by polygon index
+	std::vector<SContactColor>		m_colors;
+	std::vector<size_t>				m_colorContacts;
+	std::vector<size_t>				m_contactColorIndices; // color of each contact of the island being colored
+	std::vector<float>				m_colorChunkResults; // velocity change or separation of each chunk of a color
 
 	// Collision response
+	std::vector<SSolverBody>		m_solverBodies;
+	std::vector<CPolygon*>			m_solverBodyPolygons;
+	std::vector<unsigned int>		m_solverBodyIndices; // solver body of each polygon, by polygon index
 	std::vector<CContactConstraint>	m_contacts;
+	std::vector<SPairRecord*>		m_contactRecords; // warm starting data of each contact
+	CContactSolverSIMD				m_contactSolverSIMD;
+	SSolverStats					m_solverStats;
+
+	CJobSystem						m_jobs;
 };
 
 #endif
\ No newline at end of file
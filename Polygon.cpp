@@ -1,9 +1,18 @@
 #include "Polygon.h"
+
+#include <float.h>
+
+#ifndef PHYSIC_HEADLESS
+#include <GL/glew.h>
 #include <GL/glu.h>
+#endif
 
 #include "InertiaTensor.h"
 
 #include "PhysicEngine.h"
+#include "ShapeCollision.h"
+
+SNarrowPhaseStats	gNarrowPhaseStats;
 
 CPolygon::CPolygon(size_t index)
 	: m_vertexBufferId(0), m_index(index), density(0.1f)
@@ -18,10 +27,21 @@ CPolygon::~CPolygon()
 void CPolygon::Build()
 {
 	m_lines.clear();
+	m_aabbValid = false;
+	m_worldValid = false;
+
+	if (m_shapeType != EShapeType::Polygon)
+	{
+		// symmetric around their position, no recentering, and drawn without buffers
+		ComputeRoundMassProperties();
+		BuildLines();
+		return;
+	}
 
 	ComputeArea();
 	RecenterOnCenterOfMass();
 	ComputeLocalInertiaTensor();
+	ComputeInnerRadius();
 
 	CreateBuffers();
 	BuildLines();
@@ -29,6 +49,7 @@ void CPolygon::Build()
 
 void CPolygon::Draw()
 {
+#ifndef PHYSIC_HEADLESS
 	// Set transforms (qssuming model view mode is set)
 	float transfMat[16] = {	rotation.X.x, rotation.X.y, 0.0f, 0.0f,
 							rotation.Y.x, rotation.Y.y, 0.0f, 0.0f,
@@ -37,12 +58,20 @@ void CPolygon::Draw()
 	glPushMatrix();
 	glMultMatrixf(transfMat);
 
-	// Draw vertices
-	BindBuffers();
-	glDrawArrays(GL_LINE_LOOP, 0, points.size());
-	glDisableClientState(GL_VERTEX_ARRAY);
+	if (m_shapeType != EShapeType::Polygon)
+	{
+		DrawRoundShape();
+	}
+	else
+	{
+		// Draw vertices
+		BindBuffers();
+		glDrawArrays(GL_LINE_LOOP, 0, points.size());
+		glDisableClientState(GL_VERTEX_ARRAY);
+	}
 
 	glPopMatrix();
+#endif
 }
 
 size_t	CPolygon::GetIndex() const
@@ -50,6 +79,21 @@ size_t	CPolygon::GetIndex() const
 	return m_index;
 }
 
+EShapeType	CPolygon::GetShapeType() const
+{
+	return m_shapeType;
+}
+
+float	CPolygon::GetRadius() const
+{
+	return m_radius;
+}
+
+float	CPolygon::GetInnerRadius() const
+{
+	return m_innerRadius;
+}
+
 float	CPolygon::GetArea() const
 {
 	return fabsf(m_signedArea);
@@ -67,12 +111,25 @@ Vec2	CPolygon::InverseTransformPoint(const Vec2& point) const
 
 bool	CPolygon::IsPointInside(const Vec2& point) const
 {
+	UpdateWorldGeometry();
+
+	if (m_shapeType == EShapeType::Circle)
+	{
+		return (point - position).GetSqrLength() <= m_radius * m_radius;
+	}
+	if (m_shapeType == EShapeType::Capsule)
+	{
+		Vec2 start = GetWorldVertex(0);
+		Vec2 end = GetWorldVertex(1);
+		Vec2 closestPoint = start + (end - start) * ClosestSegmentFraction(start, end, point);
+		return (point - closestPoint).GetSqrLength() <= m_radius * m_radius;
+	}
+
 	float maxDist = -FLT_MAX;
 
-	for (const Line& line : m_lines)
+	for (size_t i = 0; i < m_lines.size(); ++i)
 	{
-		Line globalLine = line.Transform(rotation, position);
-		float pointDist = globalLine.GetPointDist(point);
+		float pointDist = GetWorldEdge(i).GetPointDist(point);
 		maxDist = Max(maxDist, pointDist);
 	}
 
@@ -87,9 +144,11 @@ bool	CPolygon::IsLineIntersectingPolygon(const Line& line, Vec2& colPoint, float
 	float lastDist = 0.0f;
 	bool intersecting = false;
 
-	for (const Vec2& point : points)
+	UpdateWorldGeometry();
+
+	for (size_t i = 0; i < points.size(); ++i)
 	{
-		Vec2 globalPoint = TransformPoint(point);
+		Vec2 globalPoint = GetWorldVertex(i);
 		float dist = line.GetPointDist(globalPoint);
 		if (dist < minDist)
 		{
@@ -115,9 +174,12 @@ bool	CPolygon::CheckCollision(const CPolygon& poly, Vec2& colPoint, Vec2& colNor
 	Vec2 minPoint, minNormal;
 	bool separating = false;
 
-	for (const Line& line : m_lines)
+	UpdateWorldGeometry();
+	poly.UpdateWorldGeometry();
+
+	for (size_t i = 0; i < m_lines.size(); ++i)
 	{
-		Line globalLine = line.Transform(rotation, position);
+		Line globalLine = GetWorldEdge(i);
 		Vec2 normal, point;
 		float dist;
 		separating = !poly.IsLineIntersectingPolygon(globalLine, point, dist) || separating;
@@ -129,9 +191,9 @@ bool	CPolygon::CheckCollision(const CPolygon& poly, Vec2& colPoint, Vec2& colNor
 		}
 	}
 
-	for (const Line& line : poly.m_lines)
+	for (size_t i = 0; i < poly.m_lines.size(); ++i)
 	{
-		Line globalLine = line.Transform(poly.rotation, poly.position);
+		Line globalLine = poly.GetWorldEdge(i);
 		Vec2 normal, point;
 		float dist;
 		separating = !IsLineIntersectingPolygon(globalLine, point, dist) || separating;
@@ -157,14 +219,16 @@ float CPolygon::GetInvSupport(const Vec2& point, const Vec2& dir, SFeature& feat
 {
 	float maxDist = -FLT_MAX;
 
+	UpdateWorldGeometry();
+
 	for (size_t i = 0; i < m_lines.size(); ++i)
 	{
-		Vec2 normal = rotation * m_lines[i].GetNormal();
+		Vec2 normal = GetWorldNormal(i);
 		bool bSegment = false;
-		float dist = (TransformPoint(points[i]) - point) | dir;
+		float dist = (GetWorldVertex(i) - point) | dir;
 		if (fabsf(normal | dir) >= 0.99f) //1.0f)
 		{
-			dist = Max(dist, (TransformPoint(points[(i + 1) % points.size()]) - point) | dir);
+			dist = Max(dist, (GetWorldVertex((i + 1) % points.size()) - point) | dir);
 			bSegment = true;
 		}
 		
@@ -188,9 +252,12 @@ bool CPolygon::CheckCollision2(CPolygon& poly, SCollision& collision)
 	Vec2 bestNormal;
 	Vec2 bestNormalDerivative;
 
+	UpdateWorldGeometry();
+	poly.UpdateWorldGeometry();
+
 	for (size_t i = 0; i < m_lines.size(); ++i)
 	{
-		Line globalLine = m_lines[i].Transform(rotation, position);
+		Line globalLine = GetWorldEdge(i);
 
 		SFeature feature;
 		float support = poly.GetInvSupport(globalLine.point, globalLine.GetNormal() * -1.0f, feature);
@@ -211,7 +278,7 @@ bool CPolygon::CheckCollision2(CPolygon& poly, SCollision& collision)
 
 	for (size_t i = 0; i < poly.m_lines.size(); ++i)
 	{
-		Line globalLine = poly.m_lines[i].Transform(poly.rotation, poly.position);
+		Line globalLine = poly.GetWorldEdge(i);
 
 		SFeature feature;
 		float support = GetInvSupport(globalLine.point, globalLine.GetNormal() * -1.0f, feature);
@@ -239,14 +306,30 @@ bool CPolygon::CheckCollision2(CPolygon& poly, SCollision& collision)
 
 float	CPolygon::GetSupport(const Vec2& center, const Vec2& dir) const
 {
-	float support = -FLT_MAX;
-	for (const Vec2& point : points)
+	NARROWPHASE_STAT(gNarrowPhaseStats.verticesTouched += points.size());
+
+	UpdateWorldGeometry();
+
+	const float* verticesX = m_worldVerticesX.data();
+	const float* verticesY = m_worldVerticesY.data();
+	size_t count = points.size();
+
+	// 4 independent maxima, the loop isn't bound by the latency of a single chain
+	float supports[4] = { -FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
 	{
-		Vec2 globalPoint = TransformPoint(point);
-		support = Max((globalPoint - center) | dir, support);
+		for (size_t lane = 0; lane < 4; ++lane)
+		{
+			supports[lane] = Max((verticesX[i + lane] - center.x) * dir.x + (verticesY[i + lane] - center.y) * dir.y, supports[lane]);
+		}
+	}
+	for (; i < count; ++i)
+	{
+		supports[0] = Max((verticesX[i] - center.x) * dir.x + (verticesY[i] - center.y) * dir.y, supports[0]);
 	}
 
-	return support;
+	return Max(Max(supports[0], supports[1]), Max(supports[2], supports[3]));
 }
 
 
@@ -264,29 +347,249 @@ float	CPolygon::GetInvSupport(const Vec2& center, const Vec2& dir) const
 	//return support;
 }
 
-float	CPolygon::GetMaxSeparationEdge(size_t &edgeIndex, const CPolygon& poly) const
+// The projections of a convex polygon along dir rise to a single maximum around the vertex loop
+float	CPolygon::GetSupport(const Vec2& center, const Vec2& dir, size_t& vertexIndex) const
+{
+	size_t count = points.size();
+	if (count < HILL_CLIMB_MIN_VERTICES)
+	{
+		return GetSupport(center, dir);
+	}
+
+	UpdateWorldGeometry();
+
+	const float* verticesX = m_worldVerticesX.data();
+	const float* verticesY = m_worldVerticesY.data();
+	auto project = [&](size_t i)
+	{
+		NARROWPHASE_STAT(gNarrowPhaseStats.verticesTouched++);
+		return (verticesX[i] - center.x) * dir.x + (verticesY[i] - center.y) * dir.y;
+	};
+
+	size_t index = (vertexIndex < count) ? vertexIndex : 0;
+	float support = project(index);
+
+	size_t next = (index + 1 == count) ? 0 : index + 1;
+	float nextSupport = project(next);
+	if (nextSupport > support)
+	{
+		do
+		{
+			index = next;
+			support = nextSupport;
+			next = (index + 1 == count) ? 0 : index + 1;
+			nextSupport = project(next);
+		} while (nextSupport > support);
+	}
+	else
+	{
+		size_t previous = (index == 0) ? count - 1 : index - 1;
+		float previousSupport = project(previous);
+		while (previousSupport > support)
+		{
+			index = previous;
+			support = previousSupport;
+			previous = (index == 0) ? count - 1 : index - 1;
+			previousSupport = project(previous);
+		}
+	}
+
+	vertexIndex = index;
+	return support;
+}
+
+float	CPolygon::GetInvSupport(const Vec2& center, const Vec2& dir, size_t& vertexIndex) const
+{
+	return -GetSupport(center, dir * -1.0f, vertexIndex);
+}
+
+// Edge normals turn a little from one edge to the next, so does the support vertex of poly :
+// each search starts from the previous one. Edges whose separation bound (see below) can't beat the
+// current maximum are skipped.
+float	CPolygon::GetMaxSeparationEdge(size_t &edgeIndex, const CPolygon& poly, size_t* startVertex) const
 {
 	float maxDist = -FLT_MAX;
+	size_t supportVertex = startVertex ? *startVertex : 0;
+
+	UpdateWorldGeometry();
 
+	Vec2 offset = poly.position - position;
+	float innerRadii = m_innerRadius + poly.m_innerRadius;
 	for (size_t i = 0; i < points.size(); ++i)
 	{
-		Line globalLine = m_lines[i].Transform(rotation, position);
-		float dist = poly.GetInvSupport(globalLine.point, globalLine.GetNormal());
+		Line globalLine = GetWorldEdge(i);
+		if ((globalLine.GetNormal() | offset) - innerRadii <= maxDist)
+		{
+			continue;
+		}
+
+		NARROWPHASE_STAT(gNarrowPhaseStats.edgesTested++);
+		float dist = poly.GetInvSupport(globalLine.point, globalLine.GetNormal(), supportVertex);
 		edgeIndex = Select(dist > maxDist, i, edgeIndex);
 		maxDist = Max(dist, maxDist);
 	}
 
+	if (startVertex)
+	{
+		*startVertex = supportVertex;
+	}
 	return maxDist;
 }
 
+float	CPolygon::GetEdgeSeparation(size_t edgeIndex, const CPolygon& poly, size_t& supportVertex) const
+{
+	NARROWPHASE_STAT(gNarrowPhaseStats.edgesTested++);
+
+	UpdateWorldGeometry();
+
+	Line globalLine = GetWorldEdge(edgeIndex);
+	return poly.GetInvSupport(globalLine.point, globalLine.GetNormal(), supportVertex);
+}
+
+// Separations are bounded by (edge normal | offset) - inner radii, offset going from the polygon to the other
+// shape. The edges beating the local maximum on that bound form an arc of normals around it, the rest of the
+// polygon needn't be tested.
+template <typename TGetSeparation>
+static float ClimbMaxSeparation(const CPolygon& poly, size_t &edgeIndex, const Vec2& offset, float innerRadii, float maxSeparation, TGetSeparation getSeparation)
+{
+	size_t count = poly.points.size();
+	size_t index = (edgeIndex < count) ? edgeIndex : 0;
+	float maxDist = getSeparation(index);
+
+	for (size_t step : { (size_t)1, count - 1 })
+	{
+		bool climbed = false;
+		for (;;)
+		{
+			size_t next = (index + step) % count;
+			float dist = getSeparation(next);
+			if (dist <= maxDist)
+			{
+				break;
+			}
+
+			index = next;
+			maxDist = dist;
+			climbed = true;
+		}
+
+		if (climbed)
+		{
+			break;
+		}
+	}
+
+	if (maxDist > maxSeparation)
+	{
+		edgeIndex = index;
+		return maxDist;
+	}
+
+	size_t localIndex = index;
+	size_t remaining = count - 1;
+	for (size_t step : { (size_t)1, count - 1 })
+	{
+		size_t next = localIndex;
+		while (remaining > 0)
+		{
+			next = (next + step) % count;
+			if ((poly.GetWorldNormal(next) | offset) < maxDist + innerRadii)
+			{
+				break;
+			}
+
+			--remaining;
+			float dist = getSeparation(next);
+			index = Select(dist > maxDist, next, index);
+			maxDist = Max(dist, maxDist);
+		}
+	}
+
+	edgeIndex = index;
+	return maxDist;
+}
+
+float	CPolygon::ClimbMaxSeparationEdge(size_t &edgeIndex, const CPolygon& poly, size_t* startVertex, float maxSeparation) const
+{
+	size_t supportVertex = startVertex ? *startVertex : 0;
+
+	UpdateWorldGeometry();
+
+	float maxDist = ClimbMaxSeparation(*this, edgeIndex, poly.position - position, m_innerRadius + poly.m_innerRadius, maxSeparation, [&](size_t i)
+	{
+		NARROWPHASE_STAT(gNarrowPhaseStats.edgesTested++);
+
+		Line globalLine = GetWorldEdge(i);
+		return poly.GetInvSupport(globalLine.point, globalLine.GetNormal(), supportVertex);
+	});
+
+	if (startVertex)
+	{
+		*startVertex = supportVertex;
+	}
+	return maxDist;
+}
+
+float	CPolygon::ClimbMaxPointSeparationEdge(size_t &edgeIndex, const Vec2& point, float maxSeparation) const
+{
+	UpdateWorldGeometry();
+
+	return ClimbMaxSeparation(*this, edgeIndex, point - position, m_innerRadius, maxSeparation, [&](size_t i)
+	{
+		return GetWorldNormal(i) | (point - GetWorldVertex(i));
+	});
+}
+
+// Edge normals turn around the polygon, their dot with normal falls once then rises once
+size_t	CPolygon::GetOpposingEdge(const Vec2& normal, size_t startEdge) const
+{
+	size_t count = points.size();
+	if (count < HILL_CLIMB_MIN_VERTICES)
+	{
+		return GetOpposingEdge(normal);
+	}
+
+	UpdateWorldGeometry();
+
+	size_t index = (startEdge < count) ? startEdge : 0;
+	float minDot = GetWorldNormal(index) | normal;
+
+	for (size_t step : { (size_t)1, count - 1 })
+	{
+		bool climbed = false;
+		for (;;)
+		{
+			size_t next = (index + step) % count;
+			float dot = GetWorldNormal(next) | normal;
+			if (dot >= minDot)
+			{
+				break;
+			}
+
+			index = next;
+			minDot = dot;
+			climbed = true;
+		}
+
+		if (climbed)
+		{
+			break;
+		}
+	}
+
+	return index;
+}
+
 size_t	CPolygon::GetOpposingEdge(const Vec2& normal) const
 {
 	size_t edgeIndex = 0;
 	float minDot = 1.0f;
 
+	UpdateWorldGeometry();
+
 	for (size_t i = 0; i < points.size(); ++i)
 	{
-		float dot = (rotation * m_lines[i].GetNormal()) | normal;
+		float dot = GetWorldNormal(i) | normal;
 		edgeIndex = Select(dot < minDot, i, edgeIndex);
 		minDot = Min(dot, minDot);
 	}
@@ -294,44 +597,146 @@ size_t	CPolygon::GetOpposingEdge(const Vec2& normal) const
 	return edgeIndex;
 }
 
-bool	CPolygon::CheckCollision(CPolygon& poly, struct SCollision& collision)
+// Climbing from the hinted edge proves a separation locally, an overlap only searches the edges
+// that could still beat the local maximum
+float	CPolygon::FindMaxSeparationEdge(size_t &edgeIndex, const CPolygon& poly, size_t* supportVertex, float maxSeparation) const
+{
+	if (supportVertex && points.size() >= HILL_CLIMB_MIN_VERTICES)
+	{
+		return ClimbMaxSeparationEdge(edgeIndex, poly, supportVertex, maxSeparation);
+	}
+
+	return GetMaxSeparationEdge(edgeIndex, poly, supportVertex);
+}
+
+// Pairs rarely change their separating axis from one step to the next, a single edge is then
+// enough to reject them
+static bool TestSeparatingAxis(const CPolygon& polyA, const CPolygon& polyB, SSeparationHint& hint)
+{
+	NARROWPHASE_STAT(gNarrowPhaseStats.separatingAxisTests++);
+
+	bool onA = (hint.separatingAxis == ESeparatingAxis::EdgeA);
+	const CPolygon& poly = onA ? polyA : polyB;
+	const CPolygon& otherPoly = onA ? polyB : polyA;
+	size_t edgeIndex = onA ? hint.edgeA : hint.edgeB;
+	if (edgeIndex >= poly.points.size())
+	{
+		return false;
+	}
+
+	float separation;
+	if (otherPoly.GetShapeType() == EShapeType::Circle)
+	{
+		poly.UpdateWorldGeometry();
+		separation = poly.GetWorldNormal(edgeIndex) | (otherPoly.position - poly.GetWorldVertex(edgeIndex));
+	}
+	else
+	{
+		unsigned short& hintSupport = onA ? hint.supportB : hint.supportA;
+		size_t supportVertex = hintSupport;
+		separation = poly.GetEdgeSeparation(edgeIndex, otherPoly, supportVertex);
+		hintSupport = (unsigned short)supportVertex;
+	}
+
+	// round shapes are separated beyond their radii
+	hint.separatingAxisHit = (separation > polyA.GetRadius() + polyB.GetRadius());
+	return hint.separatingAxisHit;
+}
+
+bool	CPolygon::CheckCollision(CPolygon& poly, struct SCollision& collision, SSeparationHint* hint)
 {
 	float threshold = 0;// 0.02f; // 0.01f;
 
-	size_t aEdge = 0;
-	float aSeparationDist = GetMaxSeparationEdge(aEdge, poly);
+	NARROWPHASE_STAT(gNarrowPhaseStats.pairs++);
+
+	if (hint)
+	{
+		hint->separatingAxisHit = false;
+		if (hint->separatingAxis != ESeparatingAxis::None && TestSeparatingAxis(*this, poly, *hint))
+		{
+			NARROWPHASE_STAT(gNarrowPhaseStats.separatingAxisHits++);
+			return false;
+		}
+	}
+
+	if (m_shapeType != EShapeType::Polygon || poly.m_shapeType != EShapeType::Polygon)
+	{
+		return CollideRoundShapes(*this, poly, collision, hint);
+	}
+
+	size_t aEdge = hint ? hint->edgeA : 0;
+	size_t supportB = hint ? hint->supportB : 0;
+	float aSeparationDist = FindMaxSeparationEdge(aEdge, poly, hint ? &supportB : nullptr);
+	if (hint)
+	{
+		hint->edgeA = (unsigned short)aEdge;
+		hint->supportB = (unsigned short)supportB;
+		hint->separatingAxis = (aSeparationDist > 0.0f) ? ESeparatingAxis::EdgeA : ESeparatingAxis::None;
+	}
 	if (aSeparationDist > 0.0f)
 	{
+		NARROWPHASE_STAT(gNarrowPhaseStats.separatedOnA++);
 		return false;
 	}
 
-	size_t bEdge = 0;
-	float bSeparationDist = poly.GetMaxSeparationEdge(bEdge, *this);
+	size_t bEdge = hint ? hint->edgeB : 0;
+	size_t supportA = hint ? hint->supportA : 0;
+	float bSeparationDist = poly.FindMaxSeparationEdge(bEdge, *this, hint ? &supportA : nullptr);
+	if (hint)
+	{
+		hint->edgeB = (unsigned short)bEdge;
+		hint->supportA = (unsigned short)supportA;
+		hint->separatingAxis = (bSeparationDist > 0.0f) ? ESeparatingAxis::EdgeB : ESeparatingAxis::None;
+	}
 	if (bSeparationDist > 0.0f)
 	{
+		NARROWPHASE_STAT(gNarrowPhaseStats.separatedOnB++);
 		return false;
 	}
 
+	NARROWPHASE_STAT(gNarrowPhaseStats.collisions++);
+
 	collision.manifoldSize = 0;
 
 	if (aSeparationDist > bSeparationDist + 0.1f)
 	{
-		Line aLine = m_lines[aEdge].Transform(rotation, position);
+		Line aLine = GetWorldEdge(aEdge);
 
 		Vec2 aNormal = aLine.GetNormal();
-		size_t opposingEdge = poly.GetOpposingEdge(aNormal);
-		Line opposingLine = poly.m_lines[opposingEdge].Transform(poly.rotation, poly.position);
+		size_t opposingEdge = hint ? poly.GetOpposingEdge(aNormal, hint->incidentEdgeB) : poly.GetOpposingEdge(aNormal);
+		if (hint)
+		{
+			hint->incidentEdgeB = (unsigned short)opposingEdge;
+		}
+		Line opposingLine = poly.GetWorldEdge(opposingEdge);
 
 		Vec2 points[2];
 		opposingLine.GetPoints(*points, *(points + 1));
-		Clip(aLine.point, aLine.dir, *points, *(points + 1));
-		Clip(aLine.point + aLine.dir * aLine.length, aLine.dir * -1.0f, *points, *(points + 1));
+
+		unsigned char clipSides[2] = { 0, 0 };
+		int clippedPoint = Clip(aLine.point, aLine.dir, *points, *(points + 1));
+		if (clippedPoint >= 0)
+		{
+			clipSides[clippedPoint] = 1;
+		}
+		clippedPoint = Clip(aLine.point + aLine.dir * aLine.length, aLine.dir * -1.0f, *points, *(points + 1));
+		if (clippedPoint >= 0)
+		{
+			clipSides[clippedPoint] = 2;
+		}
 
 		for (size_t i = 0; i < 2; ++i)
 		{
 			float dist = aLine.GetPointDist(points[i]);
 			if (-dist >= -threshold)
 			{
+				SContactID& id = collision.manifold[collision.manifoldSize].id;
+				id.edgeA = (unsigned short)aEdge;
+				id.edgeB = (unsigned short)opposingEdge;
+				id.incidentVertex = (unsigned char)i;
+				id.clipSide = clipSides[i];
+				id.referenceOnA = true;
+
 				collision.manifold[collision.manifoldSize].index = collision.manifoldSize;
 				collision.manifold[collision.manifoldSize].normal = aNormal;
 				collision.manifold[collision.manifoldSize].penetration = -dist;
@@ -350,23 +755,43 @@ bool	CPolygon::CheckCollision(CPolygon& poly, struct SCollision& collision)
 	}
 	else
 	{
-		Line bLine = poly.m_lines[bEdge].Transform(poly.rotation, poly.position);
+		Line bLine = poly.GetWorldEdge(bEdge);
 
 		Vec2 bNormal = bLine.GetNormal();
-		size_t opposingEdge = GetOpposingEdge(bNormal);
-		Line opposingLine = m_lines[opposingEdge].Transform(rotation, position);
+		size_t opposingEdge = hint ? GetOpposingEdge(bNormal, hint->incidentEdgeA) : GetOpposingEdge(bNormal);
+		if (hint)
+		{
+			hint->incidentEdgeA = (unsigned short)opposingEdge;
+		}
+		Line opposingLine = GetWorldEdge(opposingEdge);
 
 		Vec2 points[2];
 		opposingLine.GetPoints(*points, *(points + 1));
 
-		Clip(bLine.point, bLine.dir, *points, *(points + 1));
-		Clip(bLine.point + bLine.dir * bLine.length, bLine.dir * -1.0f, *points, *(points + 1));
+		unsigned char clipSides[2] = { 0, 0 };
+		int clippedPoint = Clip(bLine.point, bLine.dir, *points, *(points + 1));
+		if (clippedPoint >= 0)
+		{
+			clipSides[clippedPoint] = 1;
+		}
+		clippedPoint = Clip(bLine.point + bLine.dir * bLine.length, bLine.dir * -1.0f, *points, *(points + 1));
+		if (clippedPoint >= 0)
+		{
+			clipSides[clippedPoint] = 2;
+		}
 
 		for (size_t i = 0; i < 2; ++i)
 		{
 			float dist = bLine.GetPointDist(points[i]);
 			if (-dist >= -threshold)
 			{
+				SContactID& id = collision.manifold[collision.manifoldSize].id;
+				id.edgeA = (unsigned short)opposingEdge;
+				id.edgeB = (unsigned short)bEdge;
+				id.incidentVertex = (unsigned char)i;
+				id.clipSide = clipSides[i];
+				id.referenceOnA = false;
+
 				collision.manifold[collision.manifoldSize].index = collision.manifoldSize;
 				collision.manifold[collision.manifoldSize].normal = bNormal * -1.0f;
 				collision.manifold[collision.manifoldSize].penetration = -dist;
@@ -389,9 +814,11 @@ float CPolygon::UnProjectPoint(const Vec2& point, const Vec2& dir, float dist)
 {
 	float unProjectDist = 0.0f;
 
+	UpdateWorldGeometry();
+
 	for (size_t i = 0; (i < points.size()) && (unProjectDist < dist); ++i)
 	{
-		Line globalLine = m_lines[i].Transform(rotation, position);
+		Line globalLine = GetWorldEdge(i);
 		unProjectDist = Max(unProjectDist, globalLine.UnProject(point, dir));
 	}
 
@@ -401,15 +828,19 @@ float CPolygon::UnProjectPoint(const Vec2& point, const Vec2& dir, float dist)
 float CPolygon::UnProject(CPolygon& poly, const Vec2& dir, float dist)
 {
 	float unProjectDist = 0.0f;
+
+	UpdateWorldGeometry();
+	poly.UpdateWorldGeometry();
+
 	for (size_t i = 0; (i < points.size()) && (unProjectDist < dist); ++i)
 	{
-		Vec2 globalPoint = TransformPoint(points[i]);
+		Vec2 globalPoint = GetWorldVertex(i);
 		unProjectDist = Max(unProjectDist, poly.UnProjectPoint(globalPoint, dir, dist));
 	}
 
 	for (size_t i = 0; (i < poly.points.size()) && (unProjectDist < dist); ++i)
 	{
-		Vec2 globalPoint = poly.TransformPoint(poly.points[i]);
+		Vec2 globalPoint = poly.GetWorldVertex(i);
 		unProjectDist = Max(unProjectDist, UnProjectPoint(globalPoint, dir * -1.0f, dist));
 	}
 
@@ -417,13 +848,91 @@ float CPolygon::UnProject(CPolygon& poly, const Vec2& dir, float dist)
 }
 
 
-void CPolygon::UpdateAABB()
+AABB CPolygon::ComputeAABB() const
+{
+	UpdateWorldGeometry();
+
+	AABB box;
+	box.Center(position);
+	for (size_t i = 0; i < points.size(); ++i)
+	{
+		box.Extend(GetWorldVertex(i));
+	}
+	box.min -= Vec2(m_radius, m_radius);
+	box.max += Vec2(m_radius, m_radius);
+
+	return box;
+}
+
+bool CPolygon::UpdateAABB()
+{
+	if (m_aabbValid && position.x == m_aabbPosition.x && position.y == m_aabbPosition.y
+		&& rotation.X.x == m_aabbRotation.X.x && rotation.X.y == m_aabbRotation.X.y
+		&& rotation.Y.x == m_aabbRotation.Y.x && rotation.Y.y == m_aabbRotation.Y.y)
+	{
+		return false;
+	}
+
+	aabb = ComputeAABB();
+
+	m_aabbPosition = position;
+	m_aabbRotation = rotation;
+	m_aabbValid = true;
+
+	return true;
+}
+
+bool CPolygon::UpdateWorldGeometry() const
 {
-	aabb.Center(position);
-	for (const Vec2& point : points)
+	if (m_worldValid && position.x == m_worldPosition.x && position.y == m_worldPosition.y
+		&& rotation.X.x == m_worldRotation.X.x && rotation.X.y == m_worldRotation.X.y
+		&& rotation.Y.x == m_worldRotation.Y.x && rotation.Y.y == m_worldRotation.Y.y)
 	{
-		aabb.Extend(TransformPoint(point));
+		return false;
 	}
+
+	size_t count = points.size();
+	m_worldVerticesX.resize(count);
+	m_worldVerticesY.resize(count);
+	m_worldNormalsX.resize(count);
+	m_worldNormalsY.resize(count);
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		Vec2 vertex = TransformPoint(points[i]);
+		m_worldVerticesX[i] = vertex.x;
+		m_worldVerticesY[i] = vertex.y;
+
+		// same rounding as Line::Transform
+		Vec2 normal = (rotation * m_lines[i].dir).GetNormal();
+		m_worldNormalsX[i] = normal.x;
+		m_worldNormalsY[i] = normal.y;
+	}
+
+	m_worldPosition = position;
+	m_worldRotation = rotation;
+	m_worldValid = true;
+
+	return true;
+}
+
+Vec2 CPolygon::GetWorldVertex(size_t index) const
+{
+	return Vec2(m_worldVerticesX[index], m_worldVerticesY[index]);
+}
+
+Vec2 CPolygon::GetWorldNormal(size_t index) const
+{
+	return Vec2(m_worldNormalsX[index], m_worldNormalsY[index]);
+}
+
+Line CPolygon::GetWorldEdge(size_t index) const
+{
+	size_t next = (index + 1 == points.size()) ? 0 : index + 1;
+	Vec2 normal = GetWorldNormal(index);
+
+	// normal is the dir rotated by 90 degrees
+	return Line(GetWorldVertex(next), Vec2(normal.y, -normal.x), m_lines[index].length);
 }
 
 float CPolygon::GetMass() const
@@ -436,6 +945,41 @@ float CPolygon::GetInertiaTensor() const
 	return m_localInertiaTensor * GetMass();
 }
 
+EBodyType CPolygon::GetBodyType() const
+{
+	if (density > 0.0f)
+	{
+		return EBodyType::Dynamic;
+	}
+
+	return kinematic ? EBodyType::Kinematic : EBodyType::Static;
+}
+
+bool CPolygon::IsMoving() const
+{
+	return density > 0.0f || kinematic;
+}
+
+bool CPolygon::IsAwake() const
+{
+	return m_awake;
+}
+
+void CPolygon::SetAwake(bool awake)
+{
+	if (awake)
+	{
+		sleepTime = 0.0f;
+	}
+	else
+	{
+		speed = Vec2();
+		angularVelocity = 0.0f;
+	}
+
+	m_awake = awake;
+}
+
 Vec2 CPolygon::GetPointVelocity(const Vec2& point) const
 {
 	return speed + (point - position).GetNormal() * angularVelocity;
@@ -443,6 +987,7 @@ Vec2 CPolygon::GetPointVelocity(const Vec2& point) const
 
 void CPolygon::CreateBuffers()
 {
+#ifndef PHYSIC_HEADLESS
 	DestroyBuffers();
 
 	float* vertices = new float[3 * points.size()];
@@ -461,10 +1006,12 @@ void CPolygon::CreateBuffers()
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 
 	delete[] vertices;
+#endif
 }
 
 void CPolygon::BindBuffers()
 {
+#ifndef PHYSIC_HEADLESS
 	if (m_vertexBufferId != 0)
 	{
 		glBindBuffer(GL_ARRAY_BUFFER, m_vertexBufferId);
@@ -472,16 +1019,57 @@ void CPolygon::BindBuffers()
 		glEnableClientState(GL_VERTEX_ARRAY);
 		glVertexPointer(3, GL_FLOAT, 0, (void*)0);
 	}
+#endif
 }
 
 
+// Line loop in the body frame, with a radius drawn to show the rotation
+void CPolygon::DrawRoundShape() const
+{
+#ifndef PHYSIC_HEADLESS
+	const size_t arcSegments = 16;
+
+	Vec2 axis(1.0f, 0.0f);
+	Vec2 start, end;
+	if (m_shapeType == EShapeType::Capsule)
+	{
+		start = points[0];
+		end = points[1];
+		axis = (end - start).Normalized();
+	}
+	Vec2 side = axis.GetNormal();
+
+	// half circles around each end, the first one is the full circle's first half
+	glBegin(GL_LINE_LOOP);
+	for (size_t arc = 0; arc < 2; ++arc)
+	{
+		const Vec2& center = (arc == 0) ? end : start;
+		for (size_t i = 0; i <= arcSegments; ++i)
+		{
+			float angle = (float)M_PI * ((float)arc + (float)i / (float)arcSegments - 0.5f);
+			Vec2 point = center + (axis * cosf(angle) + side * sinf(angle)) * m_radius;
+			glVertex2f(point.x, point.y);
+		}
+	}
+	glEnd();
+
+	Vec2 radiusEnd = end + axis * m_radius;
+	glBegin(GL_LINES);
+	glVertex2f(0.0f, 0.0f);
+	glVertex2f(radiusEnd.x, radiusEnd.y);
+	glEnd();
+#endif
+}
+
 void CPolygon::DestroyBuffers()
 {
+#ifndef PHYSIC_HEADLESS
 	if (m_vertexBufferId != 0)
 	{
 		glDeleteBuffers(1, &m_vertexBufferId);
 		m_vertexBufferId = 0;
 	}
+#endif
 }
 
 void CPolygon::BuildLines()
@@ -529,16 +1117,56 @@ void CPolygon::RecenterOnCenterOfMass()
 	position += centroid;
 }
 
+// Fan of triangles around the center of mass, divided by the area to be per unit of mass like the round shapes
 void CPolygon::ComputeLocalInertiaTensor()
 {
-	m_localInertiaTensor = 0.0f;
-	for (size_t i = 0; i + 1 < points.size(); ++i)
+	float polarMoment = 0.0f;
+	for (size_t i = 0; i < points.size(); ++i)
 	{
 		const Vec2& pointA = points[i];
-		const Vec2& pointB = points[i + 1];
+		const Vec2& pointB = points[(i + 1) % points.size()];
 
-		m_localInertiaTensor += ComputeInertiaTensor_Triangle(Vec2(), pointA, pointB);
+		polarMoment += ComputeInertiaTensor_Triangle(Vec2(), pointA, pointB);
 	}
+
+	m_localInertiaTensor = polarMoment / m_signedArea;
 }
 
+// Distance from the center of mass to the closest edge line
+void CPolygon::ComputeInnerRadius()
+{
+	m_innerRadius = FLT_MAX;
+	for (size_t i = 0; i < points.size(); ++i)
+	{
+		const Vec2& pointA = points[i];
+		const Vec2& pointB = points[(i + 1) % points.size()];
+
+		Vec2 edge = pointB - pointA;
+		m_innerRadius = Min(fabsf(edge ^ pointA) / edge.GetLength(), m_innerRadius);
+	}
+}
+
+void CPolygon::ComputeRoundMassProperties()
+{
+	m_innerRadius = 0.0f; // the separation searches run on the core shapes, a point or a segment
+
+	float radiusSqr = m_radius * m_radius;
+	float circleArea = (float)M_PI * radiusSqr;
+
+	if (m_shapeType == EShapeType::Circle)
+	{
+		m_signedArea = circleArea;
+		m_localInertiaTensor = 0.5f * radiusSqr;
+		return;
+	}
+
+	// rectangle between the two half discs, each half disc is moved to its end by the parallel axis theorem
+	float length = (points[1] - points[0]).GetLength();
+	float halfLength = 0.5f * length;
+	float boxArea = 2.0f * m_radius * length;
+	float halfDiscCentroid = 4.0f * m_radius / (3.0f * (float)M_PI);
 
+	m_signedArea = boxArea + circleArea;
+	m_localInertiaTensor = (circleArea * (0.5f * radiusSqr + halfLength * halfLength + 2.0f * halfLength * halfDiscCentroid)
+		+ boxArea * (4.0f * radiusSqr + length * length) / 12.0f) / m_signedArea;
+}
\ No newline at end of file
@@ -1,7 +1,6 @@
 #ifndef _POLYGON_H_
 #define _POLYGON_H_
 
-#include <GL/glew.h>
 #include <vector>
 #include <memory>
 
@@ -19,21 +18,82 @@ struct SFeature
 	size_t	index;
 };
 
-struct SCacheContact
+// Max separation edges of a pair found by its last narrowphase test, the next test searches around them
+enum class ESeparatingAxis : unsigned char
 {
-	size_t	otherPoly;
-	Vec2	r;
-	float	normalImpulse;
-	float	tangentImpulse;
-	int		life;
+	None, // the pair overlapped on its last test
+	EdgeA,
+	EdgeB,
 };
 
-struct SCacheManifold
+struct SSeparationHint
 {
-	size_t size;
-	SCacheContact contacts[8];
+	unsigned short	edgeA = 0;
+	unsigned short	edgeB = 0;
+	unsigned short	incidentEdgeA = 0; // last incident edges, start of the opposing edge searches
+	unsigned short	incidentEdgeB = 0;
+	ESeparatingAxis	separatingAxis = ESeparatingAxis::None; // edge that separated the pair on its last test, tested first
+	unsigned short	supportA = 0; // last support vertices found by the edge searches of the other polygon
+	unsigned short	supportB = 0;
+	bool			separatingAxisHit = false; // the last test only needed the separating axis
+
+	// same hint for the (B, A) pair
+	SSeparationHint	GetSwapped() const
+	{
+		SSeparationHint hint = *this;
+		hint.edgeA = edgeB;
+		hint.edgeB = edgeA;
+		hint.incidentEdgeA = incidentEdgeB;
+		hint.incidentEdgeB = incidentEdgeA;
+		hint.supportA = supportB;
+		hint.supportB = supportA;
+		if (separatingAxis != ESeparatingAxis::None)
+		{
+			hint.separatingAxis = (separatingAxis == ESeparatingAxis::EdgeA) ? ESeparatingAxis::EdgeB : ESeparatingAxis::EdgeA;
+		}
+		return hint;
+	}
+};
+
+#define HILL_CLIMB_MIN_VERTICES 8 // polygons with fewer vertices are scanned linearly
+
+enum class EShapeType
+{
+	Polygon,
+	Circle,		// no points, the disc of the radius around the position
+	Capsule,	// 2 points, the segment between them inflated by the radius
+};
+
+enum class EBodyType
+{
+	Static,		// density 0, never moved by the engine
+	Kinematic,	// density 0, moved by its velocities only
+	Dynamic,
+};
+
+// Narrowphase counters, only updated when built with PHYSIC_NARROWPHASE_STATS
+struct SNarrowPhaseStats
+{
+	size_t	pairs = 0;
+	size_t	separatedOnA = 0; // early out after testing A edges
+	size_t	separatedOnB = 0; // early out after testing B edges
+	size_t	separatingAxisTests = 0; // pairs testing the separating axis of their hint
+	size_t	separatingAxisHits = 0; // early out on that axis alone
+	size_t	collisions = 0;
+	size_t	edgesTested = 0;
+	size_t	verticesTouched = 0;
+	size_t	gjkIterations = 0; // GJK collider only
+	size_t	epaIterations = 0;
 };
 
+extern SNarrowPhaseStats	gNarrowPhaseStats;
+
+#ifdef PHYSIC_NARROWPHASE_STATS
+#define NARROWPHASE_STAT(expr)	(expr)
+#else
+#define NARROWPHASE_STAT(expr)
+#endif
+
 class CPolygon
 {
 private:
@@ -52,6 +112,10 @@ public:
 	void				Draw();
 	size_t				GetIndex() const;
 
+	EShapeType			GetShapeType() const;
+	float				GetRadius() const; // 0 for polygons
+	float				GetInnerRadius() const; // of the biggest disc around position inside the core shape, 0 for round shapes
+
 	float				GetArea() const;
 
 	Vec2				TransformPoint(const Vec2& point) const;
@@ -73,9 +137,24 @@ public:
 
 	float				GetSupport(const Vec2& point, const Vec2& dir) const;
 	float				GetInvSupport(const Vec2& point, const Vec2& dir) const;
-	float				GetMaxSeparationEdge(size_t &edgeIndex, const CPolygon& poly) const;
+	// Hill climbing from vertexIndex, which receives the support vertex
+	float				GetSupport(const Vec2& point, const Vec2& dir, size_t& vertexIndex) const;
+	float				GetInvSupport(const Vec2& point, const Vec2& dir, size_t& vertexIndex) const;
+	// supportVertex, when given, is the hill climbing start of poly and receives the last support vertex
+	float				GetMaxSeparationEdge(size_t &edgeIndex, const CPolygon& poly, size_t* supportVertex = nullptr) const;
+	// Separation of poly along the normal of edgeIndex, supportVertex is the hill climbing start of poly
+	float				GetEdgeSeparation(size_t edgeIndex, const CPolygon& poly, size_t& supportVertex) const;
+	// Local maximum around edgeIndex. When it is not above maxSeparation, the edges that could still beat it
+	// are searched as well and the result is exact, otherwise poly is separated.
+	float				ClimbMaxSeparationEdge(size_t &edgeIndex, const CPolygon& poly, size_t* supportVertex = nullptr, float maxSeparation = 0.0f) const;
+	// Same for the distance of point in front of the edges
+	float				ClimbMaxPointSeparationEdge(size_t &edgeIndex, const Vec2& point, float maxSeparation) const;
+	// Climbs when supportVertex is given and the polygon has enough vertices, scans all the edges otherwise
+	float				FindMaxSeparationEdge(size_t &edgeIndex, const CPolygon& poly, size_t* supportVertex, float maxSeparation = 0.0f) const;
 	size_t				GetOpposingEdge(const Vec2& normal) const;
-	bool				CheckCollision(CPolygon& poly, struct SCollision& collision);
+	size_t				GetOpposingEdge(const Vec2& normal, size_t startEdge) const; // hill climbing from startEdge
+	// hint is read and updated, it speeds up the tests of polygons with many vertices
+	bool				CheckCollision(CPolygon& poly, struct SCollision& collision, SSeparationHint* hint = nullptr);
 
 	float				UnProjectPoint(const Vec2& point, const Vec2& dir, float dist);
 	float				UnProject(CPolygon& poly, const Vec2& dir, float dist);
@@ -84,100 +163,38 @@ public:
 
 
 
-	void				UpdateAABB();
+	// Returns false when the transform did not change since the last update
+	bool				UpdateAABB();
+	AABB				ComputeAABB() const; // of the current transform, aabb is left untouched
+
+	// World space vertices and edge normals, cached until the transform changes. Geometry queries
+	// refresh the cache themselves, the broadphase refreshes it for every moved body once per step.
+	// Edge i goes from vertex i + 1 to vertex i.
+	bool				UpdateWorldGeometry() const; // returns false when the cache was up to date
+	Vec2				GetWorldVertex(size_t index) const;
+	Vec2				GetWorldNormal(size_t index) const;
+	Line				GetWorldEdge(size_t index) const;
 
 	float				GetMass() const;
 	float				GetInertiaTensor() const;
 
 	Vec2				GetPointVelocity(const Vec2& point) const;
 
+	EBodyType			GetBodyType() const;
+	bool				IsMoving() const; // dynamic or kinematic
+
+	// Sleeping bodies are skipped by the engine until woken up
+	bool				IsAwake() const;
+	void				SetAwake(bool awake); // waking resets the sleep timer, sleeping clears velocities
+
 	// Physics
 	float				density;
+	bool				kinematic = false; // only meaningful with density 0
 	Vec2				speed;
 	float				angularVelocity = 0.0f;
 	Vec2				forces;
 	float				torques = 0.0f;
-
-	SCacheManifold		cacheManifold;
-
-	bool				GetCacheContact(CPolygon* otherPoly, const Vec2& rA, const Vec2& rB, float& normalImpulse, float& tangentImpulse)
-	{
-		if (m_index < otherPoly->m_index)
-		{
-			bool res = otherPoly->GetCacheContact(this, rB, rA, normalImpulse, tangentImpulse);
-			normalImpulse *= -1.0f;
-			tangentImpulse *= -1.0f;
-			return res;
-		}
-
-		size_t size = cacheManifold.size;
-		for (size_t i = 0; i < size; ++i)
-		{
-			SCacheContact& contact = cacheManifold.contacts[i];
-			if (contact.otherPoly == otherPoly->m_index && (contact.r - rA).GetSqrLength() < 0.1f * 0.1f)
-			{
-				normalImpulse = contact.normalImpulse;
-				tangentImpulse = contact.tangentImpulse;
-				return true;
-			}
-		}
-		
-		return false;
-	}
-
-	void				CacheContact(CPolygon* otherPoly, const Vec2& rA, const Vec2& rB, float normalImpulse, float tangentImpulse)
-	{
-		if (m_index < otherPoly->m_index)
-		{
-			otherPoly->CacheContact(this, rB, rA, -normalImpulse, -tangentImpulse);
-			return;
-		}
-
-		SCacheContact* pContact = nullptr;
-
-		size_t& size = cacheManifold.size;
-		for (size_t i = 0; i < size; ++i)
-		{
-			SCacheContact& contact = cacheManifold.contacts[i];
-			if (contact.otherPoly == otherPoly->m_index && (contact.r - rA).GetSqrLength() < 0.001f * 0.001f)
-			{
-				pContact = &contact;
-				break;
-			}
-		}
-
-		if (pContact == nullptr)
-		{
-			if (size < 8)
-			{
-				pContact = &(cacheManifold.contacts[0]) + size++;
-				pContact->otherPoly = otherPoly->m_index;
-				pContact->r = rA;
-			}
-			else
-			{
-				return;
-			}
-		}
-
-		pContact->life = 1;
-		pContact->normalImpulse = normalImpulse;
-		pContact->tangentImpulse = tangentImpulse;
-	}
-
-	void				UpdateCacheManifold()
-	{
-		int size = cacheManifold.size;
-		for (int i = size - 1; i >= 0; --i)
-		{
-			SCacheContact& contact = cacheManifold.contacts[i];
- 			if (--contact.life < 0)
-			{
-				contact = cacheManifold.contacts[size - 1];
-				cacheManifold.size--;
-			}
-		}
-	}
+	float				sleepTime = 0.0f; // time spent under the engine sleep tolerances
 
 
 private:
@@ -186,20 +203,43 @@ private:
 	void				DestroyBuffers();
 
 	void				BuildLines();
+	void				DrawRoundShape() const;
 
 	void				ComputeArea();
 	void				RecenterOnCenterOfMass(); // Area must be computed
 	void				ComputeLocalInertiaTensor(); // Must be centered on center of mass
+	void				ComputeInnerRadius(); // Must be centered on center of mass
+	void				ComputeRoundMassProperties(); // closed forms of circles and capsules
 
-	GLuint				m_vertexBufferId;
+	unsigned int		m_vertexBufferId; // GL buffer, stays 0 in headless builds
 	size_t				m_index;
 
+	EShapeType			m_shapeType = EShapeType::Polygon;
+	float				m_radius = 0.0f;
+	float				m_innerRadius = 0.0f;
+
 	std::vector<Line>	m_lines;
 
 	float				m_signedArea;
 
+	// world space geometry, structure of arrays
+	mutable std::vector<float>	m_worldVerticesX;
+	mutable std::vector<float>	m_worldVerticesY;
+	mutable std::vector<float>	m_worldNormalsX;
+	mutable std::vector<float>	m_worldNormalsY;
+	mutable Vec2		m_worldPosition;
+	mutable Mat2		m_worldRotation;
+	mutable bool		m_worldValid = false;
+
+	// transform the AABB was computed with
+	Vec2				m_aabbPosition;
+	Mat2				m_aabbRotation;
+	bool				m_aabbValid = false;
+
+	bool				m_awake = true;
+
 	// Physics
-	float				m_localInertiaTensor; // don't consider mass
+	float				m_localInertiaTensor; // per unit of mass
 };
 
 typedef std::shared_ptr<CPolygon>	CPolygonPtr;
@@ -0,0 +1,137 @@
+#include "Profiler.h"
+
+#include <string.h>
+
+#include "Maths.h"
+#include "TraceRecorder.h"
+
+static SProfileZone	CreateZone(const char* name, size_t parent, size_t depth)
+{
+	SProfileZone zone;
+	zone.name = name;
+	zone.parent = parent;
+	zone.firstChild = INVALID_PROFILE_ZONE;
+	zone.lastChild = INVALID_PROFILE_ZONE;
+	zone.nextSibling = INVALID_PROFILE_ZONE;
+	zone.depth = depth;
+	zone.startTicks = 0;
+	zone.frameTicks = 0;
+	zone.frameCalls = 0;
+	zone.totalTicks = 0;
+	zone.maxFrameTicks = 0;
+	zone.frameCount = 0;
+
+	return zone;
+}
+
+CProfiler::CProfiler()
+	: m_currentZone(0), m_frameCount(0)
+{
+	m_zones.push_back(CreateZone("Frame", INVALID_PROFILE_ZONE, 0));
+}
+
+void	CProfiler::BeginFrame()
+{
+	for (SProfileZone& zone : m_zones)
+	{
+		zone.frameTicks = 0;
+		zone.frameCalls = 0;
+	}
+
+	m_currentZone = 0;
+	m_zones[0].startTicks = GetClockTicks();
+	m_zones[0].frameCalls = 1;
+}
+
+void	CProfiler::EndFrame()
+{
+	SProfileZone& root = m_zones[0];
+	TClockTicks endTicks = GetClockTicks();
+	root.frameTicks = endTicks - root.startTicks;
+	RecordTraceEvent(root, endTicks);
+
+	for (SProfileZone& zone : m_zones)
+	{
+		if (zone.frameCalls > 0)
+		{
+			zone.totalTicks += zone.frameTicks;
+			zone.maxFrameTicks = Max(zone.maxFrameTicks, zone.frameTicks);
+			zone.frameCount++;
+		}
+	}
+
+	m_currentZone = 0;
+	m_frameCount++;
+}
+
+size_t	CProfiler::BeginZone(const char* name)
+{
+	size_t zone = FindOrAddChild(m_currentZone, name);
+	m_zones[zone].startTicks = GetClockTicks();
+	m_currentZone = zone;
+
+	return zone;
+}
+
+void	CProfiler::EndZone(size_t zone)
+{
+	SProfileZone& profileZone = m_zones[zone];
+	TClockTicks endTicks = GetClockTicks();
+	profileZone.frameTicks += endTicks - profileZone.startTicks;
+	RecordTraceEvent(profileZone, endTicks);
+	profileZone.frameCalls++;
+
+	m_currentZone = profileZone.parent;
+}
+
+void	CProfiler::ResetStats()
+{
+	for (SProfileZone& zone : m_zones)
+	{
+		zone.totalTicks = 0;
+		zone.maxFrameTicks = 0;
+		zone.frameCount = 0;
+	}
+
+	m_frameCount = 0;
+}
+
+size_t	CProfiler::GetFrameCount() const
+{
+	return m_frameCount;
+}
+
+void	CProfiler::RecordTraceEvent(const SProfileZone& zone, TClockTicks endTicks)
+{
+	if (gVars->pTraceRecorder && gVars->pTraceRecorder->IsRecording())
+	{
+		gVars->pTraceRecorder->AddEvent(zone.name, zone.startTicks, endTicks);
+	}
+}
+
+size_t	CProfiler::FindOrAddChild(size_t parent, const char* name)
+{
+	for (size_t child = m_zones[parent].firstChild; child != INVALID_PROFILE_ZONE; child = m_zones[child].nextSibling)
+	{
+		if (m_zones[child].name == name || strcmp(m_zones[child].name, name) == 0)
+		{
+			return child;
+		}
+	}
+
+	size_t zone = m_zones.size();
+	m_zones.push_back(CreateZone(name, parent, m_zones[parent].depth + 1));
+
+	SProfileZone& parentZone = m_zones[parent];
+	if (parentZone.lastChild == INVALID_PROFILE_ZONE)
+	{
+		parentZone.firstChild = zone;
+	}
+	else
+	{
+		m_zones[parentZone.lastChild].nextSibling = zone;
+	}
+	parentZone.lastChild = zone;
+
+	return zone;
+}
@@ -0,0 +1,102 @@
+#ifndef _PROFILER_H_
+#define _PROFILER_H_
+
+#include <vector>
+#include <stddef.h>
+
+#include "Timer.h"
+#include "GlobalVariables.h"
+
+#define INVALID_PROFILE_ZONE	((size_t)-1)
+
+// Node of the zone tree, a zone is identified by its name and its parent zone
+struct SProfileZone
+{
+	const char*	name;
+	size_t		parent;
+	size_t		firstChild;
+	size_t		lastChild;
+	size_t		nextSibling;
+	size_t		depth;
+
+	TClockTicks	startTicks;
+
+	// current/last frame
+	TClockTicks	frameTicks;
+	size_t		frameCalls;
+
+	// accumulated since last ResetStats()
+	TClockTicks	totalTicks;
+	TClockTicks	maxFrameTicks;
+	size_t		frameCount;
+};
+
+class CProfiler
+{
+public:
+	CProfiler();
+
+	void	BeginFrame();
+	void	EndFrame();
+
+	size_t	BeginZone(const char* name);
+	void	EndZone(size_t zone);
+
+	void	ResetStats();
+	size_t	GetFrameCount() const;
+
+	// Depth first traversal, root zone (whole frame) first
+	template<typename TFunctor>
+	void	ForEachZone(TFunctor functor) const
+	{
+		ForEachZone(0, functor);
+	}
+
+private:
+	template<typename TFunctor>
+	void	ForEachZone(size_t zone, TFunctor& functor) const
+	{
+		functor(m_zones[zone]);
+		for (size_t child = m_zones[zone].firstChild; child != INVALID_PROFILE_ZONE; child = m_zones[child].nextSibling)
+		{
+			ForEachZone(child, functor);
+		}
+	}
+
+	size_t	FindOrAddChild(size_t parent, const char* name);
+	void	RecordTraceEvent(const SProfileZone& zone, TClockTicks endTicks);
+
+	std::vector<SProfileZone>	m_zones;
+	size_t						m_currentZone;
+	size_t						m_frameCount;
+};
+
+// RAII zone, nested scopes build the hierarchy (main thread only, see TRACE_ZONE for workers)
+class CProfileScope
+{
+public:
+	CProfileScope(const char* name)
+		: m_zone((gVars && gVars->pProfiler) ? gVars->pProfiler->BeginZone(name) : INVALID_PROFILE_ZONE){}
+
+	~CProfileScope()
+	{
+		if (m_zone != INVALID_PROFILE_ZONE)
+		{
+			gVars->pProfiler->EndZone(m_zone);
+		}
+	}
+
+private:
+	size_t	m_zone;
+};
+
+// Define PHYSIC_NO_PROFILER to compile zones out
+#ifndef PHYSIC_NO_PROFILER
+#define PROFILE_CONCAT_IMPL(a, b)	a##b
+#define PROFILE_CONCAT(a, b)		PROFILE_CONCAT_IMPL(a, b)
+#define PROFILE_ZONE(name)			CProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#else
+#define PROFILE_ZONE(name)
+#endif
+
+#endif
\ No newline at end of file
@@ -1,5 +1,7 @@
 #include <stdlib.h>
+#ifndef PHYSIC_HEADLESS
 #include <GL/glew.h>
+#endif
 
 #include <stdio.h>
 #include <iostream>
@@ -12,8 +14,12 @@
 #include "PhysicEngine.h"
 #include "SceneManager.h"
 #include "World.h"
+#include "Profiler.h"
+#include "TraceRecorder.h"
 
+#ifndef PHYSIC_HEADLESS
 #include "drawtext.h"
+#endif
 
 CRenderer::CRenderer(float worldHeight)
 	: m_worldHeight(worldHeight), m_lastFPS(0.0f), m_lastFPSSince(0.0f), m_textCursor(0), m_FPS(FPS::Unlocked)
@@ -58,11 +64,15 @@ void CRenderer::DisplayTextWorld(const std::string& text, const Vec2& worldPos)
 
 void CRenderer::DrawLine(const Vec2& from, const Vec2& to, float r, float g, float b)
 {
+#ifndef PHYSIC_HEADLESS
 	glColor3f(r, g, b);
 	glBegin(GL_LINES);
 	glVertex3f(from.x, from.y, -1.0f);
 	glVertex3f(to.x, to.y, -1.0f);
 	glEnd();
+#else
+	(void)from; (void)to; (void)r; (void)g; (void)b;
+#endif
 }
 
 Vec2 CRenderer::ScreenToWorldPos(const Vec2& pos) const
@@ -83,11 +93,13 @@ Vec2 CRenderer::WorldToScreenPos(const Vec2& pos) const
 
 void CRenderer::Init()
 {
+#ifndef PHYSIC_HEADLESS
 	// Init font
 	m_font = dtx_open_font("font.ttf", 24);
 	dtx_use_font(m_font, 24);
+#endif
 
-	m_frameTimer.Start();
+	m_frameStartTicks = GetClockTicks();
 
 	// Load scene 0
 	gVars->pSceneManager->LoadScene(0);
@@ -104,18 +116,24 @@ void CRenderer::Reset()
 
 void CRenderer::Reshape(int width, int height)
 {
+#ifndef PHYSIC_HEADLESS
 	glViewport(0, 0, width, height);
+#else
+	(void)width; (void)height;
+#endif
 }
 
 void CRenderer::Update()
 {
-	CTimer timer;
+	gVars->pProfiler->BeginFrame();
 
 	if (gVars->pRenderWindow->JustPressedKey(Key::F4))
 	{
 		gVars->bDebug = !gVars->bDebug;
 	}
 
+	UpdateTraceRecording();
+
 	gVars->pSceneManager->CheckSceneUpdate();
 
 	PreRenderFrame();
@@ -123,26 +141,31 @@ void CRenderer::Update()
 	float frameTime = UpdateFrameTime();
 	DrawFPS(frameTime);
 
-	Vec2 extents(GetWorldWidth(), GetWorldHeight());
-	gVars->pFluidSystem->SetBounds(extents * -0.5f, extents * 0.5f);
-	gVars->pFluidSystem->Update(frameTime);
+	{
+		PROFILE_ZONE("Fluid");
+
+		Vec2 extents(GetWorldWidth(), GetWorldHeight());
+		gVars->pFluidSystem->SetBounds(extents * -0.5f, extents * 0.5f);
+		gVars->pFluidSystem->Update(frameTime);
+	}
 
 	gVars->pPhysicEngine->Step(frameTime);
 	
-	timer.Start();
-	UpdateWorld(frameTime);
-	timer.Stop(); 
-	if (gVars->bDebug)
 	{
-		DisplayText("Update duration : " + std::to_string(timer.GetDuration()));
+		PROFILE_ZONE("Behaviors");
+		UpdateWorld(frameTime);
 	}
 
-	timer.Start();
-	RenderPolygons();
-	timer.Stop();
+	{
+		PROFILE_ZONE("Render");
+		RenderPolygons();
+	}
+
+	gVars->pProfiler->EndFrame();
+
 	if (gVars->bDebug)
 	{
-		DisplayText("Render duration : " + std::to_string(timer.GetDuration()));
+		DrawProfiler();
 	}
 
 	RenderTexts();
@@ -152,6 +175,7 @@ void CRenderer::Update()
 
 void  CRenderer::SetProjectionMatrix()
 {
+#ifndef PHYSIC_HEADLESS
 	int width = gVars->pRenderWindow->GetWidth();
 	int height = gVars->pRenderWindow->Getheight();
 	float ratio = (float)width / (float)height;
@@ -159,10 +183,12 @@ void  CRenderer::SetProjectionMatrix()
 	glMatrixMode(GL_PROJECTION);
 	glLoadIdentity();
 	glOrtho(-m_worldHeight * 0.5f * ratio, m_worldHeight * 0.5f * ratio, -m_worldHeight * 0.5f, m_worldHeight * 0.5f, 0.1f, 10.0f);
+#endif
 }
 
 void  CRenderer::PreRenderFrame()
 {
+#ifndef PHYSIC_HEADLESS
 	glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
 	glClear(GL_COLOR_BUFFER_BIT);
 
@@ -170,6 +196,7 @@ void  CRenderer::PreRenderFrame()
 
 	glMatrixMode(GL_MODELVIEW);
 	glTranslatef(0.0f, 0.0f, 0.0f); // move camera here
+#endif
 }
 
 void  CRenderer::DrawFPS(float frameTime)
@@ -199,6 +226,9 @@ void  CRenderer::UpdateWorld(float frameTime)
 
 void  CRenderer::RenderPolygons()
 {
+	gVars->pFluidSystem->Render();
+
+#ifndef PHYSIC_HEADLESS
 	glColor3f(0.0f, 0.0f, 0.0f);
 
 	glPushMatrix();
@@ -209,10 +239,12 @@ void  CRenderer::RenderPolygons()
 	}
 
 	glPopMatrix();
+#endif
 }
 
 void  CRenderer::RenderTexts()
 {
+#ifndef PHYSIC_HEADLESS
 	int width = gVars->pRenderWindow->GetWidth();
 	int height = gVars->pRenderWindow->Getheight();
 
@@ -237,6 +269,7 @@ void  CRenderer::RenderTexts()
 
 		glPopMatrix();
 	}
+#endif
 
 	m_renderTexts.clear();
 	m_textCursor = 0;
@@ -252,19 +285,44 @@ void  CRenderer::UpdateLockFPS()
 	if (m_FPS != FPS::Unlocked)
 	{
 		float frameTimeLimit = (m_FPS == FPS::Locked30) ? 1.0f / 30.0f : 1.0f / 60.0f;
-		do
-		{
-			m_frameTimer.Stop();
-		} while (m_frameTimer.GetDuration() < frameTimeLimit);
+		while (GetSecondsSince(m_frameStartTicks) < frameTimeLimit);
 	}
 }
 
 float  CRenderer::UpdateFrameTime()
 {
-	m_frameTimer.Stop();
-	float frameTime = m_frameTimer.GetDuration();
-	m_frameTimer.Start();
+	TClockTicks ticks = GetClockTicks();
+	float frameTime = ClockTicksToSeconds(ticks - m_frameStartTicks);
+	m_frameStartTicks = ticks;
 
 	return frameTime;
 }
 
+void  CRenderer::UpdateTraceRecording()
+{
+	if (gVars->pRenderWindow->JustPressedKey(Key::F6))
+	{
+		if (gVars->pTraceRecorder->IsRecording())
+		{
+			gVars->pTraceRecorder->Stop();
+		}
+		else
+		{
+			gVars->pTraceRecorder->Start("trace.json");
+		}
+	}
+
+	if (gVars->pTraceRecorder->IsRecording())
+	{
+		DisplayText("Recording trace (F6 to stop)");
+	}
+}
+
+void  CRenderer::DrawProfiler()
+{
+	gVars->pProfiler->ForEachZone([&](const SProfileZone& zone)
+	{
+		DisplayText(std::string(zone.depth * 4, ' ') + zone.name + " : " + std::to_string(ClockTicksToSeconds(zone.frameTicks) * 1000.0f) + " ms");
+	});
+}
+
@@ -2,6 +2,7 @@
 #define _RENDERER_H_
 
 #include <vector>
+#include <string>
 
 #include "Timer.h"
 #include "Maths.h"
@@ -56,13 +57,15 @@ private:
 	void	RenderPolygons();
 	void	RenderTexts();
 	void	UpdateLockFPS();
+	void	UpdateTraceRecording();
+	void	DrawProfiler();
 
 	float	UpdateFrameTime();
 
 private:
 	float m_worldHeight; // height in world units
 
-	CTimer m_frameTimer;
+	TClockTicks m_frameStartTicks;
 
 	std::vector<SRenderText>	m_renderTexts;
 	int							m_textCursor;
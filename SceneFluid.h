@@ -1,7 +1,7 @@
 #ifndef _SCENE_FLUID_H_
 #define _SCENE_FLUID_H_
 
-#include "Scenes\BaseScene.h"
+#include "Scenes/BaseScene.h"
 
 #include "FluidSpawner.h"
 
@@ -2,6 +2,7 @@
 #define _SCENE_MANAGER_H_
 
 #include <vector>
+#include <stddef.h>
 
 class IScene
 {
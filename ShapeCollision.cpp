@@ -0,0 +1,328 @@
+#include "ShapeCollision.h"
+
+#include <float.h>
+#include <utility>
+
+// the reference face is only taken on B when it is clearly more separating, keeps the choice stable
+#define ROUND_SHAPE_FACE_TOLERANCE 0.001f
+
+static void AddContact(SCollision& collision, CPolygon& polyA, CPolygon& polyB, const Vec2& point, const Vec2& normal, float penetration,
+	const SContactID& id, const Vec2& edgeNormalA, const Vec2& edgeNormalB)
+{
+	SContactInfo& contact = collision.manifold[collision.manifoldSize];
+	contact.index = collision.manifoldSize;
+	contact.pA = &polyA;
+	contact.pB = &polyB;
+	contact.point = point;
+	contact.normal = normal;
+	contact.penetration = penetration;
+	contact.edgeNormalA = edgeNormalA;
+	contact.edgeNormalB = edgeNormalB;
+	contact.id = id;
+
+	collision.manifoldSize++;
+}
+
+// The routines below handle a single order of the shapes, this gives the manifold of the other one
+static void FlipManifold(SCollision& collision)
+{
+	for (size_t i = 0; i < collision.manifoldSize; ++i)
+	{
+		SContactInfo& contact = collision.manifold[i];
+		std::swap(contact.pA, contact.pB);
+		std::swap(contact.edgeNormalA, contact.edgeNormalB);
+		contact.normal = contact.normal * -1.0f;
+		contact.id = contact.id.GetSwapped();
+	}
+}
+
+static bool CollideCircles(CPolygon& circleA, CPolygon& circleB, SCollision& collision)
+{
+	Vec2 offset = circleB.position - circleA.position;
+	float radius = circleA.GetRadius() + circleB.GetRadius();
+	float sqrDist = offset.GetSqrLength();
+	if (sqrDist > radius * radius)
+	{
+		return false;
+	}
+
+	float dist = sqrtf(sqrDist);
+	Vec2 normal = (dist > FLT_EPSILON) ? offset / dist : Vec2(0.0f, 1.0f);
+
+	SContactID id;
+	AddContact(collision, circleA, circleB, circleB.position - normal * circleB.GetRadius(), normal, radius - dist, id, normal, normal * -1.0f);
+	return true;
+}
+
+// Face of the polygon the center is the most in front of, or its closest vertex when the center is
+// beyond the face ends. The incident vertex of the ID tells them apart (0 : face, 1 : start, 2 : end).
+// The polygon is A for the hint, its face search climbs from the hinted edge.
+static bool CollidePolygonCircle(CPolygon& polygon, CPolygon& circle, SCollision& collision, SSeparationHint* hint)
+{
+	polygon.UpdateWorldGeometry();
+
+	Vec2 center = circle.position;
+	float radius = circle.GetRadius();
+
+	float separation = -FLT_MAX;
+	size_t edge = 0;
+	if (hint && polygon.points.size() >= HILL_CLIMB_MIN_VERTICES)
+	{
+		edge = hint->edgeA;
+		separation = polygon.ClimbMaxPointSeparationEdge(edge, center, radius);
+	}
+	else
+	{
+		for (size_t i = 0; i < polygon.points.size(); ++i)
+		{
+			float dist = polygon.GetWorldNormal(i) | (center - polygon.GetWorldVertex(i));
+			if (dist > separation)
+			{
+				separation = dist;
+				edge = i;
+			}
+			if (dist > radius)
+			{
+				break;
+			}
+		}
+	}
+
+	if (hint)
+	{
+		hint->edgeA = (unsigned short)edge;
+		hint->separatingAxis = (separation > radius) ? ESeparatingAxis::EdgeA : ESeparatingAxis::None;
+	}
+	if (separation > radius)
+	{
+		return false;
+	}
+
+	Vec2 edgeNormal = polygon.GetWorldNormal(edge);
+	Vec2 normal = edgeNormal;
+	float penetration = radius - separation;
+
+	SContactID id;
+	id.edgeA = (unsigned short)edge;
+
+	if (separation > 0.0f)
+	{
+		Vec2 start, end;
+		polygon.GetWorldEdge(edge).GetPoints(start, end);
+
+		float fraction = ClosestSegmentFraction(start, end, center);
+		if (fraction <= 0.0f || fraction >= 1.0f)
+		{
+			Vec2 offset = center - ((fraction <= 0.0f) ? start : end);
+			float sqrDist = offset.GetSqrLength();
+			if (sqrDist > radius * radius)
+			{
+				return false;
+			}
+
+			float dist = sqrtf(sqrDist);
+			normal = offset / dist;
+			penetration = radius - dist;
+			id.incidentVertex = (fraction <= 0.0f) ? 1 : 2;
+		}
+	}
+
+	AddContact(collision, polygon, circle, center - normal * radius, normal, penetration, id, edgeNormal, normal * -1.0f);
+	return true;
+}
+
+static bool CollideCapsuleCircle(CPolygon& capsule, CPolygon& circle, SCollision& collision)
+{
+	capsule.UpdateWorldGeometry();
+
+	Vec2 start = capsule.GetWorldVertex(0);
+	Vec2 end = capsule.GetWorldVertex(1);
+	float fraction = ClosestSegmentFraction(start, end, circle.position);
+
+	Vec2 offset = circle.position - (start + (end - start) * fraction);
+	float radius = capsule.GetRadius() + circle.GetRadius();
+	float sqrDist = offset.GetSqrLength();
+	if (sqrDist > radius * radius)
+	{
+		return false;
+	}
+
+	float dist = sqrtf(sqrDist);
+	Vec2 normal = (dist > FLT_EPSILON) ? offset / dist : capsule.GetWorldNormal(0);
+
+	SContactID id;
+	id.incidentVertex = (fraction <= 0.0f) ? 1 : ((fraction >= 1.0f) ? 2 : 0);
+	AddContact(collision, capsule, circle, circle.position - normal * circle.GetRadius(), normal, radius - dist, id, normal, normal * -1.0f);
+	return true;
+}
+
+// Capsules against polygons or capsules : the polygon clipping on the core shapes (the capsule
+// segment has its two sides as edges), with the contacts pushed out by the radii
+static bool CollideRoundedHulls(CPolygon& polyA, CPolygon& polyB, SCollision& collision, SSeparationHint* hint)
+{
+	float radius = polyA.GetRadius() + polyB.GetRadius();
+
+	size_t edgeA = hint ? hint->edgeA : 0;
+	size_t supportB = hint ? hint->supportB : 0;
+	float separationA = polyA.FindMaxSeparationEdge(edgeA, polyB, hint ? &supportB : nullptr, radius);
+	if (hint)
+	{
+		hint->edgeA = (unsigned short)edgeA;
+		hint->supportB = (unsigned short)supportB;
+		hint->separatingAxis = (separationA > radius) ? ESeparatingAxis::EdgeA : ESeparatingAxis::None;
+	}
+	if (separationA > radius)
+	{
+		return false;
+	}
+
+	size_t edgeB = hint ? hint->edgeB : 0;
+	size_t supportA = hint ? hint->supportA : 0;
+	float separationB = polyB.FindMaxSeparationEdge(edgeB, polyA, hint ? &supportA : nullptr, radius);
+	if (hint)
+	{
+		hint->edgeB = (unsigned short)edgeB;
+		hint->supportA = (unsigned short)supportA;
+		hint->separatingAxis = (separationB > radius) ? ESeparatingAxis::EdgeB : ESeparatingAxis::None;
+	}
+	if (separationB > radius)
+	{
+		return false;
+	}
+
+	bool flip = separationB > separationA + ROUND_SHAPE_FACE_TOLERANCE;
+	CPolygon& reference = flip ? polyB : polyA;
+	CPolygon& incident = flip ? polyA : polyB;
+	size_t referenceEdge = flip ? edgeB : edgeA;
+	float separation = flip ? separationB : separationA;
+	unsigned short* hintIncidentEdge = hint ? (flip ? &hint->incidentEdgeA : &hint->incidentEdgeB) : nullptr;
+
+	// Apart cores can have two vertices as closest features, the rounded ends then touch along the line between them
+	if (separation > ROUND_SHAPE_FACE_TOLERANCE)
+	{
+		Vec2 referenceStart, referenceEnd;
+		reference.GetWorldEdge(referenceEdge).GetPoints(referenceStart, referenceEnd);
+		Vec2 referenceNormal = reference.GetWorldNormal(referenceEdge);
+		size_t incidentEdge = hintIncidentEdge ? incident.GetOpposingEdge(referenceNormal, *hintIncidentEdge) : incident.GetOpposingEdge(referenceNormal);
+		if (hintIncidentEdge)
+		{
+			*hintIncidentEdge = (unsigned short)incidentEdge;
+		}
+		Vec2 incidentStart, incidentEnd;
+		incident.GetWorldEdge(incidentEdge).GetPoints(incidentStart, incidentEnd);
+
+		float referenceFraction, incidentFraction;
+		ClosestSegmentsFractions(referenceStart, referenceEnd, incidentStart, incidentEnd, referenceFraction, incidentFraction);
+		if ((referenceFraction == 0.0f || referenceFraction == 1.0f) && (incidentFraction == 0.0f || incidentFraction == 1.0f))
+		{
+			Vec2 referencePoint = referenceStart + (referenceEnd - referenceStart) * referenceFraction;
+			Vec2 incidentPoint = incidentStart + (incidentEnd - incidentStart) * incidentFraction;
+			Vec2 offset = incidentPoint - referencePoint;
+			float sqrDist = offset.GetSqrLength();
+			if (sqrDist > radius * radius)
+			{
+				return false;
+			}
+
+			float dist = sqrtf(sqrDist);
+			Vec2 normal = offset / dist;
+
+			SContactID id;
+			id.edgeA = (unsigned short)(flip ? incidentEdge : referenceEdge);
+			id.edgeB = (unsigned short)(flip ? referenceEdge : incidentEdge);
+			id.incidentVertex = (incidentFraction == 0.0f) ? 0 : 1;
+			id.referenceOnA = !flip;
+
+			Vec2 incidentNormal = incident.GetWorldNormal(incidentEdge);
+			AddContact(collision, polyA, polyB, incidentPoint - normal * incident.GetRadius(), flip ? normal * -1.0f : normal, radius - dist, id,
+				flip ? incidentNormal : referenceNormal, flip ? referenceNormal : incidentNormal);
+			return true;
+		}
+	}
+
+	AddClippedContacts(polyA, polyB, !flip, referenceEdge, 0.0f, collision, hintIncidentEdge);
+	return collision.manifoldSize > 0;
+}
+
+void AddClippedContacts(CPolygon& polyA, CPolygon& polyB, bool referenceOnA, size_t referenceEdge, float maxSeparation, SCollision& collision,
+	unsigned short* hintIncidentEdge)
+{
+	CPolygon& reference = referenceOnA ? polyA : polyB;
+	CPolygon& incident = referenceOnA ? polyB : polyA;
+	float radius = polyA.GetRadius() + polyB.GetRadius();
+
+	Line referenceLine = reference.GetWorldEdge(referenceEdge);
+	Vec2 referenceNormal = reference.GetWorldNormal(referenceEdge);
+	size_t incidentEdge = hintIncidentEdge ? incident.GetOpposingEdge(referenceNormal, *hintIncidentEdge) : incident.GetOpposingEdge(referenceNormal);
+	if (hintIncidentEdge)
+	{
+		*hintIncidentEdge = (unsigned short)incidentEdge;
+	}
+	Vec2 incidentNormal = incident.GetWorldNormal(incidentEdge);
+
+	Vec2 referenceStart, referenceEnd;
+	referenceLine.GetPoints(referenceStart, referenceEnd);
+	Vec2 points[2];
+	incident.GetWorldEdge(incidentEdge).GetPoints(points[0], points[1]);
+
+	unsigned char clipSides[2] = { 0, 0 };
+	int clippedPoint = Clip(referenceStart, referenceLine.dir, points[0], points[1]);
+	if (clippedPoint >= 0)
+	{
+		clipSides[clippedPoint] = 1;
+	}
+	clippedPoint = Clip(referenceEnd, referenceLine.dir * -1.0f, points[0], points[1]);
+	if (clippedPoint >= 0)
+	{
+		clipSides[clippedPoint] = 2;
+	}
+
+	SContactID id;
+	id.edgeA = (unsigned short)(referenceOnA ? referenceEdge : incidentEdge);
+	id.edgeB = (unsigned short)(referenceOnA ? incidentEdge : referenceEdge);
+	id.referenceOnA = referenceOnA;
+
+	for (size_t i = 0; i < 2; ++i)
+	{
+		float dist = (referenceNormal | (points[i] - referenceStart)) - radius;
+		if (dist <= maxSeparation)
+		{
+			id.incidentVertex = (unsigned char)i;
+			id.clipSide = clipSides[i];
+			AddContact(collision, polyA, polyB, points[i] - referenceNormal * incident.GetRadius(), referenceOnA ? referenceNormal : referenceNormal * -1.0f, -dist, id,
+				referenceOnA ? referenceNormal : incidentNormal, referenceOnA ? incidentNormal : referenceNormal);
+		}
+	}
+}
+
+bool CollideRoundShapes(CPolygon& polyA, CPolygon& polyB, SCollision& collision, SSeparationHint* hint)
+{
+	collision.manifoldSize = 0;
+
+	EShapeType typeA = polyA.GetShapeType();
+	EShapeType typeB = polyB.GetShapeType();
+
+	if (typeA == EShapeType::Circle && typeB == EShapeType::Circle)
+	{
+		return CollideCircles(polyA, polyB, collision);
+	}
+
+	if (typeB == EShapeType::Circle)
+	{
+		return (typeA == EShapeType::Capsule) ? CollideCapsuleCircle(polyA, polyB, collision) : CollidePolygonCircle(polyA, polyB, collision, hint);
+	}
+
+	if (typeA == EShapeType::Circle)
+	{
+		SSeparationHint swappedHint = hint ? hint->GetSwapped() : SSeparationHint();
+		bool colliding = (typeB == EShapeType::Capsule) ? CollideCapsuleCircle(polyB, polyA, collision) : CollidePolygonCircle(polyB, polyA, collision, hint ? &swappedHint : nullptr);
+		if (hint)
+		{
+			*hint = swappedHint.GetSwapped();
+		}
+		FlipManifold(collision);
+		return colliding;
+	}
+
+	return CollideRoundedHulls(polyA, polyB, collision, hint);
+}
\ No newline at end of file
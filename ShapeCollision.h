@@ -0,0 +1,17 @@
+#ifndef _SHAPE_COLLISION_H_
+#define _SHAPE_COLLISION_H_
+
+#include "Collision.h"
+
+// Analytic manifolds of the pairs with a circle or a capsule, called by CPolygon::CheckCollision.
+// As for polygon pairs, the normal goes from polyA to polyB and the points lie on the incident surface.
+// hint is read and updated as in CPolygon::CheckCollision.
+bool	CollideRoundShapes(CPolygon& polyA, CPolygon& polyB, SCollision& collision, SSeparationHint* hint = nullptr);
+
+// Clips the edge of the incident shape facing the reference edge by the sides of the latter, and adds
+// the clipped points separated by less than maxSeparation from it, radii included.
+// hintIncidentEdge, when given, is the hill climbing start of the incident edge search and receives it.
+void	AddClippedContacts(CPolygon& polyA, CPolygon& polyB, bool referenceOnA, size_t referenceEdge, float maxSeparation, SCollision& collision,
+	unsigned short* hintIncidentEdge = nullptr);
+
+#endif
\ No newline at end of file
@@ -1,17 +1,18 @@
 #include "Timer.h"
 
-void CTimer::Start()
+#include <chrono>
+
+TClockTicks	GetClockTicks()
 {
-	QueryPerformanceFrequency(&m_frequency);
-	QueryPerformanceCounter(&m_startTime);
+	return (TClockTicks)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
 }
 
-void CTimer::Stop()
+float	ClockTicksToSeconds(TClockTicks ticks)
 {
-	QueryPerformanceCounter(&m_stopTime);
+	return (float)((double)ticks * 1e-9);
 }
 
-float	CTimer::GetDuration() const
+float	GetSecondsSince(TClockTicks startTicks)
 {
-	return (float)(m_stopTime.QuadPart - m_startTime.QuadPart) / (float)m_frequency.QuadPart;
+	return ClockTicksToSeconds(GetClockTicks() - startTicks);
 }
\ No newline at end of file
@@ -1,20 +1,12 @@
 #ifndef _TIMER_H_
 #define _TIMER_H_
 
-#include <Windows.h>
+// Portable monotonic clock, ticks are nanoseconds
+typedef unsigned long long	TClockTicks;
 
-class CTimer
-{
-public:
-	void Start();
-	void Stop();
+TClockTicks	GetClockTicks();
 
-	float	GetDuration() const;
-
-private:
-	LARGE_INTEGER	m_frequency;
-	LARGE_INTEGER	m_startTime;
-	LARGE_INTEGER	m_stopTime;
-};
+float		ClockTicksToSeconds(TClockTicks ticks);
+float		GetSecondsSince(TClockTicks startTicks);
 
 #endif
\ No newline at end of file
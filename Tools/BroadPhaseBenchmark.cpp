@@ -0,0 +1,319 @@
+// BroadPhaseBenchmark.cpp : drives every IBroadPhase through synthetic frames and compares them
+//
+// Build with PHYSIC_HEADLESS defined, from every engine translation unit except main.cpp,
+// stdafx.cpp, SDLRenderWindow.cpp and the other Tools (no GL, GLEW, SDL or drawtext needed).
+// New broadphases are compared by adding them to GetBroadPhaseFactories().
+//
+// Usage : BroadPhaseBenchmark [maxBodies] [frames] [coherence] [seed]
+//		coherence in [0, 1] : 1 = bodies only drift, 0 = every moving body teleports each frame
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <algorithm>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "GlobalVariables.h"
+#include "BroadPhase.h"
+#include "BroadPhaseBrut.h"
+#include "BroadPhaseSweepAndPrune.h"
+#include "BroadPhaseAABBTree.h"
+#include "BroadPhaseGrid.h"
+#include "Polygon.h"
+#include "Timer.h"
+#include "World.h"
+
+enum class EDistribution
+{
+	Uniform,
+	Clustered,
+	TallStacks,
+	MostlyStatic,
+
+	Count,
+};
+
+static const char* s_distributionNames[] = { "uniform", "clustered", "tall stacks", "mostly static" };
+
+struct SBroadPhaseFactory
+{
+	const char*						name;
+	std::function<IBroadPhase*()>	create;
+	size_t							maxBodies; // 0 : no limit
+};
+
+static std::vector<SBroadPhaseFactory> GetBroadPhaseFactories()
+{
+	return
+	{
+		{ "brute force", [](){ return new CBroadPhaseBrut(); }, 5000 },
+		{ "sweep and prune", [](){ return new CBroadPhaseSweepAndPrune(); }, 0 },
+		{ "AABB tree", [](){ return new CBroadPhaseAABBTree(); }, 0 },
+		{ "grid", [](){ return new CBroadPhaseGrid(); }, 0 },
+	};
+}
+
+struct SBody
+{
+	CPolygonPtr	poly;
+	Vec2		velocity;
+	bool		moving;
+};
+
+class CSyntheticScene
+{
+public:
+	CSyntheticScene(unsigned int seed, float coherence)
+		: m_random(seed), m_coherence(coherence){}
+
+	void	Create(CWorld& world, EDistribution distribution, size_t bodyCount)
+	{
+		m_bodies.clear();
+
+		float halfExtent = sqrtf((float)bodyCount) * 1.5f;
+		m_min = Vec2(-halfExtent, -halfExtent);
+		m_max = Vec2(halfExtent, halfExtent);
+
+		size_t clusterCount = Max(bodyCount / 500, (size_t)1);
+		std::vector<Vec2> clusters;
+		for (size_t i = 0; i < clusterCount; ++i)
+		{
+			clusters.push_back(Vec2(RandomFloat(m_min.x, m_max.x), RandomFloat(m_min.y, m_max.y)));
+		}
+
+		// columns of touching 0.5 boxes, as CSceneSmallPhysic but much taller
+		size_t columnCount = Max(bodyCount / 1000, (size_t)4);
+		size_t columnHeight = (bodyCount + columnCount - 1) / columnCount;
+
+		std::normal_distribution<float> clusterSpread(0.0f, 4.0f);
+
+		for (size_t i = 0; i < bodyCount; ++i)
+		{
+			SBody body;
+			body.moving = true;
+
+			switch (distribution)
+			{
+			case EDistribution::Uniform:
+				body.poly = world.AddRectangle(RandomFloat(0.5f, 1.5f), RandomFloat(0.5f, 1.5f));
+				body.poly->position = Vec2(RandomFloat(m_min.x, m_max.x), RandomFloat(m_min.y, m_max.y));
+				break;
+
+			case EDistribution::Clustered:
+				body.poly = world.AddRectangle(RandomFloat(0.5f, 1.5f), RandomFloat(0.5f, 1.5f));
+				body.poly->position = clusters[i % clusterCount] + Vec2(clusterSpread(m_random), clusterSpread(m_random));
+				break;
+
+			case EDistribution::TallStacks:
+				body.poly = world.AddSquare(0.5f);
+				body.poly->position = Vec2(m_min.x + (float)(i / columnHeight) * 2.0f, m_min.y + (float)(i % columnHeight) * 0.5f);
+				break;
+
+			default:
+				body.poly = world.AddRectangle(RandomFloat(0.5f, 1.5f), RandomFloat(0.5f, 1.5f));
+				body.poly->position = Vec2(RandomFloat(m_min.x, m_max.x), RandomFloat(m_min.y, m_max.y));
+				body.moving = RandomFloat(0.0f, 1.0f) < 0.1f;
+				break;
+			}
+
+			if (distribution != EDistribution::TallStacks)
+			{
+				body.poly->rotation.SetAngle(RandomFloat(-180.0f, 180.0f));
+			}
+
+			body.poly->density = body.moving ? 0.1f : 0.0f;
+			body.velocity = Vec2(RandomFloat(-1.0f, 1.0f), RandomFloat(-1.0f, 1.0f)) * ((distribution == EDistribution::TallStacks) ? 0.05f : 2.0f);
+
+			m_bodies.push_back(body);
+		}
+
+		UpdateAABBs();
+	}
+
+	void	Move(float deltaTime)
+	{
+		for (SBody& body : m_bodies)
+		{
+			if (!body.moving)
+			{
+				continue;
+			}
+
+			Vec2& pos = body.poly->position;
+			if (RandomFloat(0.0f, 1.0f) >= m_coherence)
+			{
+				pos = Vec2(RandomFloat(m_min.x, m_max.x), RandomFloat(m_min.y, m_max.y));
+				continue;
+			}
+
+			pos += body.velocity * deltaTime;
+			if ((pos.x < m_min.x && body.velocity.x < 0.0f) || (pos.x > m_max.x && body.velocity.x > 0.0f))
+			{
+				body.velocity.x *= -1.0f;
+			}
+			if ((pos.y < m_min.y && body.velocity.y < 0.0f) || (pos.y > m_max.y && body.velocity.y > 0.0f))
+			{
+				body.velocity.y *= -1.0f;
+			}
+		}
+
+		UpdateAABBs();
+	}
+
+	// Exact AABB overlaps between bodies where at least one can move
+	size_t	CountExactOverlaps()
+	{
+		m_sorted.clear();
+		for (const SBody& body : m_bodies)
+		{
+			m_sorted.push_back(body.poly.get());
+		}
+		std::sort(m_sorted.begin(), m_sorted.end(), [](const CPolygon* a, const CPolygon* b){ return a->aabb.min.x < b->aabb.min.x; });
+
+		size_t overlaps = 0;
+		for (size_t i = 0; i < m_sorted.size(); ++i)
+		{
+			const CPolygon* polyA = m_sorted[i];
+			for (size_t j = i + 1; j < m_sorted.size() && m_sorted[j]->aabb.min.x <= polyA->aabb.max.x; ++j)
+			{
+				const CPolygon* polyB = m_sorted[j];
+				if ((polyA->density > 0.0f || polyB->density > 0.0f) && polyA->aabb.Intersect(polyB->aabb))
+				{
+					++overlaps;
+				}
+			}
+		}
+
+		return overlaps;
+	}
+
+private:
+	float	RandomFloat(float from, float to)
+	{
+		return std::uniform_real_distribution<float>(from, to)(m_random);
+	}
+
+	void	UpdateAABBs()
+	{
+		for (SBody& body : m_bodies)
+		{
+			body.poly->UpdateAABB();
+		}
+	}
+
+	std::mt19937				m_random;
+	float						m_coherence;
+	Vec2						m_min, m_max;
+	std::vector<SBody>			m_bodies;
+	std::vector<const CPolygon*>	m_sorted;
+};
+
+struct SFrameStats
+{
+	float	firstFrameTime = 0.0f;
+	float	totalTime = 0.0f;
+	size_t	pairs = 0;
+	size_t	falsePositives = 0;
+	size_t	exactOverlaps = 0;
+};
+
+static SFrameStats RunBroadPhase(const SBroadPhaseFactory& factory, EDistribution distribution, size_t bodyCount, size_t frameCount, float coherence, unsigned int seed)
+{
+	CWorld world;
+	gVars->pWorld = &world;
+
+	CSyntheticScene scene(seed, coherence);
+	scene.Create(world, distribution, bodyCount);
+
+	IBroadPhase* broadPhase = factory.create();
+
+	SFrameStats stats;
+	std::vector<SPolygonPair> pairs;
+	for (size_t frame = 0; frame < frameCount; ++frame)
+	{
+		if (frame > 0)
+		{
+			scene.Move(1.0f / 60.0f);
+		}
+
+		pairs.clear();
+
+		TClockTicks startTicks = GetClockTicks();
+		broadPhase->GetCollidingPairsToCheck(pairs);
+		float duration = GetSecondsSince(startTicks);
+
+		if (frame == 0)
+		{
+			stats.firstFrameTime = duration;
+			continue;
+		}
+
+		stats.totalTime += duration;
+		stats.pairs += pairs.size();
+		stats.exactOverlaps += scene.CountExactOverlaps();
+		for (const SPolygonPair& pair : pairs)
+		{
+			stats.falsePositives += pair.polyA->aabb.Intersect(pair.polyB->aabb) ? 0 : 1;
+		}
+	}
+
+	delete broadPhase;
+	gVars->pWorld = nullptr;
+
+	return stats;
+}
+
+int main(int argc, char** argv)
+{
+	size_t maxBodies = (argc > 1) ? (size_t)atoi(argv[1]) : 200000;
+	size_t frameCount = (argc > 2) ? (size_t)atoi(argv[2]) : 10;
+	float coherence = (argc > 3) ? (float)atof(argv[3]) : 0.99f;
+	unsigned int seed = (argc > 4) ? (unsigned int)atoi(argv[4]) : 1234;
+
+	frameCount = Max(frameCount, (size_t)2);
+
+	gVars = new SGlobalVariables();
+	gVars->bDebug = false;
+
+	// a broadphase slower than this per frame is skipped for larger body counts
+	const float frameBudget = 1.0f;
+
+	printf("%u frames (first one reported apart), coherence %.2f, seed %u\n", (unsigned int)frameCount, coherence, seed);
+	printf("%-16s %-14s %8s %11s %11s %10s %10s %8s %8s\n", "broadphase", "distribution", "bodies", "first (ms)", "frame (ms)", "pairs", "overlaps", "false +", "missed");
+
+	size_t bodyCounts[] = { 1000, 5000, 20000, 50000, 100000, 200000 };
+
+	for (const SBroadPhaseFactory& factory : GetBroadPhaseFactories())
+	{
+		for (int distribution = 0; distribution < (int)EDistribution::Count; ++distribution)
+		{
+			for (size_t bodyCount : bodyCounts)
+			{
+				if (bodyCount > maxBodies || (factory.maxBodies > 0 && bodyCount > factory.maxBodies))
+				{
+					break;
+				}
+
+				SFrameStats stats = RunBroadPhase(factory, (EDistribution)distribution, bodyCount, frameCount, coherence, seed);
+
+				float measuredFrames = (float)(frameCount - 1);
+				float pairs = (float)stats.pairs / measuredFrames;
+				float overlaps = (float)stats.exactOverlaps / measuredFrames;
+				float truePositives = (float)(stats.pairs - stats.falsePositives) / measuredFrames;
+				float falsePositiveRatio = (stats.pairs > 0) ? (float)stats.falsePositives / (float)stats.pairs : 0.0f;
+
+				printf("%-16s %-14s %8u %11.3f %11.3f %10.0f %10.0f %7.1f%% %8.0f\n", factory.name, s_distributionNames[distribution], (unsigned int)bodyCount,
+					stats.firstFrameTime * 1000.0f, stats.totalTime * 1000.0f / measuredFrames, pairs, overlaps, falsePositiveRatio * 100.0f, Max(overlaps - truePositives, 0.0f));
+
+				if (stats.firstFrameTime > frameBudget || stats.totalTime / measuredFrames > frameBudget)
+				{
+					break;
+				}
+			}
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,151 @@
+// HeadlessRunner.cpp : steps a scene without SDL nor OpenGL and prints the profiler zone tree
+//
+// Build with PHYSIC_HEADLESS defined, from every engine translation unit except
+// main.cpp, stdafx.cpp and SDLRenderWindow.cpp (no GL, GLEW, SDL or drawtext needed).
+//
+// Usage : HeadlessRunner [sceneIndex] [frameCount] [deltaTime] [traceFile.json|-] [sat|gjk]
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string>
+
+#include "GlobalVariables.h"
+#include "HeadlessRenderWindow.h"
+#include "PhysicEngine.h"
+#include "Renderer.h"
+#include "SceneManager.h"
+#include "World.h"
+#include "FluidSystem.h"
+#include "Profiler.h"
+#include "TraceRecorder.h"
+
+#include "SceneFluid.h"
+#include "Scenes/SceneSmallPhysic.h"
+#include "Scenes/SceneSimplePhysic.h"
+#include "Scenes/SceneComplexPhysic.h"
+#include "Scenes/SceneBouncingPolys.h"
+
+static void PrintProfile(const CProfiler& profiler)
+{
+	size_t frameCount = Max(profiler.GetFrameCount(), (size_t)1);
+
+	printf("%-28s %12s %12s %12s %8s\n", "zone", "total (ms)", "avg (ms)", "max (ms)", "frames");
+	profiler.ForEachZone([&](const SProfileZone& zone)
+	{
+		std::string name = std::string(zone.depth * 2, ' ') + zone.name;
+		float total = ClockTicksToSeconds(zone.totalTicks) * 1000.0f;
+		float max = ClockTicksToSeconds(zone.maxFrameTicks) * 1000.0f;
+		printf("%-28s %12.3f %12.4f %12.4f %8u\n", name.c_str(), total, total / (float)frameCount, max, (unsigned int)zone.frameCount);
+	});
+}
+
+int main(int argc, char** argv)
+{
+	size_t sceneIndex = (argc > 1) ? (size_t)atoi(argv[1]) : 1;
+	size_t frameCount = (argc > 2) ? (size_t)atoi(argv[2]) : 600;
+	float deltaTime = (argc > 3) ? (float)atof(argv[3]) : 1.0f / 60.0f;
+	const char* tracePath = (argc > 4 && std::string(argv[4]) != "-") ? argv[4] : nullptr;
+	bool useGJK = (argc > 5) && std::string(argv[5]) == "gjk";
+
+	gVars = new SGlobalVariables();
+
+	gVars->pRenderWindow = new CHeadlessRenderWindow(1260, 768);
+	gVars->pRenderer = new CRenderer(50.0f);
+	gVars->pSceneManager = new CSceneManager();
+	gVars->pPhysicEngine = new CPhysicEngine();
+	gVars->pFluidSystem = new CFluidSystem();
+	gVars->pProfiler = new CProfiler();
+	gVars->pTraceRecorder = new CTraceRecorder();
+	gVars->pWorld = nullptr;
+
+	gVars->bDebug = false;
+
+	// Same scenes as the windowed application, plus a crowded one
+	gVars->pSceneManager->AddScene(new CSceneFluid());
+	gVars->pSceneManager->AddScene(new CSceneSmallPhysic());
+	gVars->pSceneManager->AddScene(new CSceneSimplePhysic());
+	gVars->pSceneManager->AddScene(new CSceneComplexPhysic(25));
+	gVars->pSceneManager->AddScene(new CSceneBouncingPolys(200));
+
+	gVars->pPhysicEngine->narrowPhase = useGJK ? ENarrowPhase::GJK : ENarrowPhase::SAT;
+	gVars->pSceneManager->LoadScene(sceneIndex);
+	if (gVars->pWorld == nullptr)
+	{
+		printf("Invalid scene index %u\n", (unsigned int)sceneIndex);
+		return 1;
+	}
+
+	printf("Scene %u, %u polygons, %u frames, dt = %f s, %s narrowphase\n", (unsigned int)sceneIndex, (unsigned int)gVars->pWorld->GetPolygonCount(), (unsigned int)frameCount, deltaTime, useGJK ? "GJK" : "SAT");
+
+	if (tracePath)
+	{
+		gVars->pTraceRecorder->Start(tracePath);
+	}
+
+	SSolverStats totalStats;
+	size_t solvedFrames = 0;
+	SSeparatingAxisStats totalAxisStats;
+
+	for (size_t frame = 0; frame < frameCount; ++frame)
+	{
+		gVars->pProfiler->BeginFrame();
+
+		{
+			PROFILE_ZONE("Fluid");
+
+			Vec2 extents(gVars->pRenderer->GetWorldWidth(), gVars->pRenderer->GetWorldHeight());
+			gVars->pFluidSystem->SetBounds(extents * -0.5f, extents * 0.5f);
+			gVars->pFluidSystem->Update(deltaTime);
+		}
+
+		gVars->pPhysicEngine->Step(deltaTime);
+
+		const SSolverStats& stats = gVars->pPhysicEngine->GetSolverStats();
+		if (stats.islandCount > 0)
+		{
+			++solvedFrames;
+			totalStats.islandCount += stats.islandCount;
+			totalStats.velocityIterations += stats.velocityIterations;
+			totalStats.maxVelocityIterations = Max(totalStats.maxVelocityIterations, stats.maxVelocityIterations);
+			totalStats.maxVelocityResidual = Max(totalStats.maxVelocityResidual, stats.maxVelocityResidual);
+			totalStats.positionIterations += stats.positionIterations;
+			totalStats.maxPositionIterations = Max(totalStats.maxPositionIterations, stats.maxPositionIterations);
+			totalStats.maxPositionResidual = Max(totalStats.maxPositionResidual, stats.maxPositionResidual);
+			totalStats.unconvergedIslands += stats.unconvergedIslands;
+		}
+
+		const SSeparatingAxisStats& axisStats = gVars->pPhysicEngine->GetSeparatingAxisStats();
+		totalAxisStats.tests += axisStats.tests;
+		totalAxisStats.hits += axisStats.hits;
+
+		{
+			PROFILE_ZONE("Behaviors");
+			gVars->pWorld->Update(deltaTime);
+		}
+
+		gVars->pProfiler->EndFrame();
+	}
+
+	gVars->pTraceRecorder->Stop();
+
+	PrintProfile(*gVars->pProfiler);
+
+	if (solvedFrames > 0)
+	{
+		float islandCount = (float)totalStats.islandCount;
+		printf("Solver, %u frames with islands, per island : %.2f velocity iterations (max %u, max residual %g), %.2f position iterations (max %u, max residual %g), %.1f%% unconverged\n",
+			(unsigned int)solvedFrames, (float)totalStats.velocityIterations / islandCount, (unsigned int)totalStats.maxVelocityIterations, totalStats.maxVelocityResidual,
+			(float)totalStats.positionIterations / islandCount, (unsigned int)totalStats.maxPositionIterations, totalStats.maxPositionResidual,
+			100.0f * (float)totalStats.unconvergedIslands / islandCount);
+	}
+
+	if (totalAxisStats.tests > 0)
+	{
+		printf("Separating axes, %u pairs separated on their previous test, %.1f%% still separated by the same edge\n",
+			(unsigned int)totalAxisStats.tests, 100.0f * (float)totalAxisStats.hits / (float)totalAxisStats.tests);
+	}
+
+	gVars->pSceneManager->Reset();
+
+	return 0;
+}
@@ -0,0 +1,276 @@
+// NarrowPhaseBenchmark.cpp : times CPolygon::CheckCollision and CollideGJK over reproducible corpora of polygon pairs
+//
+// Build with PHYSIC_HEADLESS defined from Tools/NarrowPhaseBenchmark.cpp, Polygon.cpp, ShapeCollision.cpp, NarrowPhaseGJK.cpp,
+// World.cpp, Maths.cpp, InertiaTensor.cpp, Timer.cpp and GlobaleVariables.cpp. Define PHYSIC_NARROWPHASE_STATS as well
+// to get early out rates and vertex/edge counters (they cost a few percents of the timings).
+//
+// Pairs are timed without and with separation hints (which keep the separating axis of the pair), then with GJK without and with simplex caches
+// (hints and caches are warmed by a first pass, as in the engine).
+//
+// Usage : NarrowPhaseBenchmark [pairsPerCorpus] [repetitions] [seed]
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Collision.h"
+#include "NarrowPhaseGJK.h"
+#include "Polygon.h"
+#include "Timer.h"
+#include "World.h"
+
+enum class EShape
+{
+	Triangle,
+	Box,
+	Octagon,
+	Circle, // 50-gon, as the scenes made circles before the native shapes
+	FineCircle,
+	NativeCircle,
+	Capsule,
+
+	Count,
+};
+
+enum class EPlacement
+{
+	Separated,
+	Touching,
+	Penetrating,
+
+	Count,
+};
+
+static const char* s_shapeNames[] = { "triangle", "box", "8-gon", "50-gon", "200-gon", "circle", "capsule" };
+static const char* s_placementNames[] = { "separated", "touching", "penetrating" };
+
+struct SCorpus
+{
+	EShape						shapeA, shapeB;
+	EPlacement					placement;
+	std::vector<SPolygonPair>	pairs;
+};
+
+class CCorpusGenerator
+{
+public:
+	CCorpusGenerator(unsigned int seed) : m_random(seed){}
+
+	SCorpus	Generate(CWorld& world, EShape shapeA, EShape shapeB, EPlacement placement, size_t pairCount)
+	{
+		SCorpus corpus;
+		corpus.shapeA = shapeA;
+		corpus.shapeB = shapeB;
+		corpus.placement = placement;
+
+		for (size_t i = 0; i < pairCount; ++i)
+		{
+			CPolygonPtr polyA = AddShape(world, shapeA);
+			CPolygonPtr polyB = AddShape(world, shapeB);
+			Place(polyA, polyB, placement);
+			corpus.pairs.push_back(SPolygonPair(polyA, polyB));
+		}
+
+		return corpus;
+	}
+
+private:
+	float		RandomFloat(float from, float to)
+	{
+		return std::uniform_real_distribution<float>(from, to)(m_random);
+	}
+
+	CPolygonPtr	AddShape(CWorld& world, EShape shape)
+	{
+		CPolygonPtr poly;
+		switch (shape)
+		{
+		case EShape::Triangle:	poly = world.AddTriangle(1.2f, 1.0f); break;
+		case EShape::Box:		poly = world.AddSquare(1.0f); break;
+		case EShape::Octagon:	poly = world.AddSymetricPolygon(0.6f, 8); break;
+		case EShape::Circle:	poly = world.AddSymetricPolygon(0.6f, 50); break;
+		case EShape::FineCircle:	poly = world.AddSymetricPolygon(0.6f, 200); break;
+		case EShape::NativeCircle:	poly = world.AddCircle(0.6f); break;
+		default:				poly = world.AddCapsule(0.6f, 0.3f); break;
+		}
+
+		poly->position = Vec2();
+		poly->rotation.SetAngle(RandomFloat(-180.0f, 180.0f));
+		return poly;
+	}
+
+	// B is moved along a random direction relatively to A, the contact distance is found by bisection
+	void		Place(CPolygonPtr polyA, CPolygonPtr polyB, EPlacement placement)
+	{
+		Mat2 dirRotation;
+		dirRotation.SetAngle(RandomFloat(-180.0f, 180.0f));
+		Vec2 dir = dirRotation.X;
+
+		float minDist = 0.0f;
+		float maxDist = 4.0f;
+		for (size_t i = 0; i < 32; ++i)
+		{
+			float dist = 0.5f * (minDist + maxDist);
+			polyB->position = dir * dist;
+
+			SCollision collision;
+			if (polyA->CheckCollision(*polyB, collision))
+			{
+				minDist = dist;
+			}
+			else
+			{
+				maxDist = dist;
+			}
+		}
+
+		float contactDist = maxDist;
+		switch (placement)
+		{
+		case EPlacement::Separated:		contactDist += RandomFloat(0.05f, 0.5f); break;
+		case EPlacement::Touching:		contactDist -= RandomFloat(0.001f, 0.01f); break;
+		default:						contactDist -= RandomFloat(0.2f, 0.35f); break;
+		}
+
+		polyB->position = dir * contactDist;
+		polyA->UpdateAABB();
+		polyB->UpdateAABB();
+	}
+
+	std::mt19937	m_random;
+};
+
+static void RunCorpus(const SCorpus& corpus, size_t repetitions)
+{
+	gNarrowPhaseStats = SNarrowPhaseStats();
+
+	// warm up, also gives the counters for one pass
+	size_t collisions = 0;
+	for (const SPolygonPair& pair : corpus.pairs)
+	{
+		SCollision collision;
+		collisions += pair.polyA->CheckCollision(*pair.polyB, collision) ? 1 : 0;
+	}
+#ifdef PHYSIC_NARROWPHASE_STATS
+	SNarrowPhaseStats stats = gNarrowPhaseStats;
+#endif
+
+	TClockTicks startTicks = GetClockTicks();
+	for (size_t repetition = 0; repetition < repetitions; ++repetition)
+	{
+		for (const SPolygonPair& pair : corpus.pairs)
+		{
+			SCollision collision;
+			pair.polyA->CheckCollision(*pair.polyB, collision);
+		}
+	}
+	TClockTicks duration = GetClockTicks() - startTicks;
+
+	std::vector<SSeparationHint> hints(corpus.pairs.size());
+	for (size_t i = 0; i < corpus.pairs.size(); ++i)
+	{
+		SCollision collision;
+		corpus.pairs[i].polyA->CheckCollision(*corpus.pairs[i].polyB, collision, &hints[i]);
+	}
+
+	gNarrowPhaseStats = SNarrowPhaseStats();
+	TClockTicks hintedStartTicks = GetClockTicks();
+	for (size_t repetition = 0; repetition < repetitions; ++repetition)
+	{
+		for (size_t i = 0; i < corpus.pairs.size(); ++i)
+		{
+			SCollision collision;
+			corpus.pairs[i].polyA->CheckCollision(*corpus.pairs[i].polyB, collision, &hints[i]);
+		}
+	}
+	TClockTicks hintedDuration = GetClockTicks() - hintedStartTicks;
+#ifdef PHYSIC_NARROWPHASE_STATS
+	SNarrowPhaseStats hintedStats = gNarrowPhaseStats;
+#endif
+
+	gNarrowPhaseStats = SNarrowPhaseStats();
+	std::vector<SSimplexCache> caches(corpus.pairs.size());
+	for (size_t i = 0; i < corpus.pairs.size(); ++i)
+	{
+		SCollision collision;
+		CollideGJK(*corpus.pairs[i].polyA, *corpus.pairs[i].polyB, collision, 0.0f, &caches[i]);
+	}
+#ifdef PHYSIC_NARROWPHASE_STATS
+	SNarrowPhaseStats gjkStats = gNarrowPhaseStats;
+#endif
+
+	TClockTicks gjkStartTicks = GetClockTicks();
+	for (size_t repetition = 0; repetition < repetitions; ++repetition)
+	{
+		for (const SPolygonPair& pair : corpus.pairs)
+		{
+			SCollision collision;
+			CollideGJK(*pair.polyA, *pair.polyB, collision);
+		}
+	}
+	TClockTicks gjkDuration = GetClockTicks() - gjkStartTicks;
+
+	gNarrowPhaseStats = SNarrowPhaseStats();
+	TClockTicks cachedStartTicks = GetClockTicks();
+	for (size_t repetition = 0; repetition < repetitions; ++repetition)
+	{
+		for (size_t i = 0; i < corpus.pairs.size(); ++i)
+		{
+			SCollision collision;
+			CollideGJK(*corpus.pairs[i].polyA, *corpus.pairs[i].polyB, collision, 0.0f, &caches[i]);
+		}
+	}
+	TClockTicks cachedDuration = GetClockTicks() - cachedStartTicks;
+#ifdef PHYSIC_NARROWPHASE_STATS
+	SNarrowPhaseStats cachedStats = gNarrowPhaseStats;
+#endif
+
+	float pairCount = (float)corpus.pairs.size();
+	float nsPerPair = (float)duration / (pairCount * (float)repetitions);
+	float hintedNsPerPair = (float)hintedDuration / (pairCount * (float)repetitions);
+	float gjkNsPerPair = (float)gjkDuration / (pairCount * (float)repetitions);
+	float cachedNsPerPair = (float)cachedDuration / (pairCount * (float)repetitions);
+	std::string name = std::string(s_shapeNames[(int)corpus.shapeA]) + " / " + s_shapeNames[(int)corpus.shapeB];
+
+	printf("%-20s %-12s %10.1f %10.1f %10.1f %10.1f %8.1f%%", name.c_str(), s_placementNames[(int)corpus.placement], nsPerPair, hintedNsPerPair,
+		gjkNsPerPair, cachedNsPerPair, 100.0f * (float)collisions / pairCount);
+
+#ifdef PHYSIC_NARROWPHASE_STATS
+	float cachedCount = pairCount * (float)repetitions;
+	float axisTests = (float)Max(hintedStats.separatingAxisTests, (size_t)1);
+	printf(" %10.1f%% %10.1f%% %10.1f %10.1f %10.1f%% %10.2f %10.2f %10.2f\n", 100.0f * (float)stats.separatedOnA / pairCount, 100.0f * (float)stats.separatedOnB / pairCount,
+		(float)stats.edgesTested / pairCount, (float)stats.verticesTouched / pairCount, 100.0f * (float)hintedStats.separatingAxisHits / axisTests,
+		(float)gjkStats.gjkIterations / pairCount, (float)cachedStats.gjkIterations / cachedCount, (float)gjkStats.epaIterations / pairCount);
+#else
+	printf(" %11s %11s %10s %10s %11s %10s %10s %10s\n", "n/a", "n/a", "n/a", "n/a", "n/a", "n/a", "n/a", "n/a");
+#endif
+}
+
+int main(int argc, char** argv)
+{
+	size_t pairCount = (argc > 1) ? (size_t)atoi(argv[1]) : 1000;
+	size_t repetitions = (argc > 2) ? (size_t)atoi(argv[2]) : 50;
+	unsigned int seed = (argc > 3) ? (unsigned int)atoi(argv[3]) : 1234;
+
+	printf("%u pairs per corpus, %u repetitions, seed %u\n", (unsigned int)pairCount, (unsigned int)repetitions, seed);
+	printf("%-20s %-12s %10s %10s %10s %10s %9s %11s %11s %10s %10s %11s %10s %10s %10s\n", "shapes", "placement", "ns/pair", "hinted", "gjk", "cached", "colliding",
+		"early out A", "early out B", "edges", "vertices", "axis hits", "gjk iters", "cached", "epa iters");
+
+	CCorpusGenerator generator(seed);
+	for (int shapeA = 0; shapeA < (int)EShape::Count; ++shapeA)
+	{
+		for (int shapeB = shapeA; shapeB < (int)EShape::Count; ++shapeB)
+		{
+			for (int placement = 0; placement < (int)EPlacement::Count; ++placement)
+			{
+				CWorld world;
+				SCorpus corpus = generator.Generate(world, (EShape)shapeA, (EShape)shapeB, (EPlacement)placement, pairCount);
+				RunCorpus(corpus, repetitions);
+			}
+		}
+	}
+
+	return 0;
+}
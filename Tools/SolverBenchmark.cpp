@@ -0,0 +1,183 @@
+// SolverBenchmark.cpp : steps the stacking scenes with both step modes and increasing solver thread counts
+//
+// Build with PHYSIC_HEADLESS defined, from every engine translation unit except main.cpp,
+// stdafx.cpp, SDLRenderWindow.cpp and the other Tools (no GL, GLEW, SDL or drawtext needed).
+// Prints the solver timings, the speedup against one thread, the average penetration and a hash
+// of the final body states, which must be the same for every thread count of a step mode.
+//
+// Usage : SolverBenchmark [frameCount] [maxThreads]
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <thread>
+
+#include "GlobalVariables.h"
+#include "HeadlessRenderWindow.h"
+#include "PhysicEngine.h"
+#include "Renderer.h"
+#include "SceneManager.h"
+#include "World.h"
+#include "FluidSystem.h"
+#include "Profiler.h"
+#include "TraceRecorder.h"
+
+#include "Scenes/SceneSmallPhysic.h"
+#include "Scenes/SceneComplexPhysic.h"
+
+struct SRunResult
+{
+	float				velocityMs;
+	float				positionMs;
+	float				subStepsMs;
+	float				physicsMs;
+	float				averagePenetration;
+	unsigned long long	stateHash;
+};
+
+// FNV-1a over the bits of the body positions, rotations and velocities
+static unsigned long long HashWorldState()
+{
+	unsigned long long hash = 14695981039346656037ull;
+	auto hashFloat = [&](float value)
+	{
+		unsigned int bits;
+		memcpy(&bits, &value, sizeof(bits));
+		for (size_t i = 0; i < sizeof(bits); ++i)
+		{
+			hash = (hash ^ ((bits >> (i * 8)) & 0xFF)) * 1099511628211ull;
+		}
+	};
+
+	gVars->pWorld->ForEachPolygon([&](CPolygonPtr poly)
+	{
+		hashFloat(poly->position.x);
+		hashFloat(poly->position.y);
+		hashFloat(poly->rotation.GetAngle());
+		hashFloat(poly->speed.x);
+		hashFloat(poly->speed.y);
+		hashFloat(poly->angularVelocity);
+	});
+
+	return hash;
+}
+
+static SRunResult RunScene(size_t sceneIndex, EStepMode stepMode, size_t threadCount, size_t frameCount)
+{
+	delete gVars->pProfiler;
+	gVars->pProfiler = new CProfiler();
+
+	// same random polygons for every run
+	srand(1234);
+
+	gVars->pPhysicEngine->stepMode = stepMode;
+	gVars->pPhysicEngine->workerThreads = threadCount - 1;
+	gVars->pSceneManager->LoadScene(sceneIndex);
+
+	SRunResult result = {};
+	size_t contactCount = 0;
+
+	float deltaTime = 1.0f / 60.0f;
+	for (size_t frame = 0; frame < frameCount; ++frame)
+	{
+		gVars->pProfiler->BeginFrame();
+		gVars->pPhysicEngine->Step(deltaTime);
+		gVars->pWorld->Update(deltaTime);
+		gVars->pProfiler->EndFrame();
+
+		gVars->pPhysicEngine->ForEachCollision([&](const SCollision& collision)
+		{
+			for (size_t i = 0; i < collision.manifoldSize; ++i)
+			{
+				result.averagePenetration += collision.manifold[i].penetration;
+				++contactCount;
+			}
+		});
+	}
+	result.averagePenetration /= (float)Max(contactCount, (size_t)1);
+
+	gVars->pProfiler->ForEachZone([&](const SProfileZone& zone)
+	{
+		float ms = ClockTicksToSeconds(zone.totalTicks) * 1000.0f;
+		if (strcmp(zone.name, "VelocitySolve") == 0)
+		{
+			result.velocityMs = ms;
+		}
+		else if (strcmp(zone.name, "PositionSolve") == 0)
+		{
+			result.positionMs = ms;
+		}
+		else if (strcmp(zone.name, "SubSteps") == 0)
+		{
+			result.subStepsMs = ms;
+		}
+		else if (strcmp(zone.name, "Physics") == 0)
+		{
+			result.physicsMs = ms;
+		}
+	});
+	result.stateHash = HashWorldState();
+
+	return result;
+}
+
+int main(int argc, char** argv)
+{
+	size_t frameCount = (argc > 1) ? (size_t)atoi(argv[1]) : 300;
+	size_t maxThreads = (argc > 2) ? (size_t)atoi(argv[2]) : Max((size_t)std::thread::hardware_concurrency(), (size_t)1);
+
+	gVars = new SGlobalVariables();
+
+	gVars->pRenderWindow = new CHeadlessRenderWindow(1260, 768);
+	gVars->pRenderer = new CRenderer(50.0f);
+	gVars->pSceneManager = new CSceneManager();
+	gVars->pPhysicEngine = new CPhysicEngine();
+	gVars->pFluidSystem = new CFluidSystem();
+	gVars->pProfiler = nullptr;
+	gVars->pTraceRecorder = new CTraceRecorder();
+	gVars->pWorld = nullptr;
+
+	gVars->bDebug = false;
+
+	gVars->pSceneManager->AddScene(new CSceneSmallPhysic());
+	gVars->pSceneManager->AddScene(new CSceneComplexPhysic(25));
+	const char* sceneNames[] = { "small physic", "complex physic (25)" };
+	const char* stepModeNames[] = { "PGS", "soft substeps" };
+
+	printf("%u frames, up to %u threads\n", (unsigned int)frameCount, (unsigned int)maxThreads);
+	printf("%-20s %-14s %8s %14s %14s %14s %12s %8s %11s %16s\n", "scene", "step mode", "threads", "velocity (ms)", "position (ms)", "substeps (ms)",
+		"physics (ms)", "speedup", "penetration", "state hash");
+
+	for (size_t sceneIndex = 0; sceneIndex < 2; ++sceneIndex)
+	{
+		for (EStepMode stepMode : { EStepMode::PGS, EStepMode::SoftSubSteps })
+		{
+			SRunResult reference = {};
+			for (size_t threadCount = 1; ; threadCount = Min(threadCount * 2, maxThreads))
+			{
+				SRunResult result = RunScene(sceneIndex, stepMode, threadCount, frameCount);
+				if (threadCount == 1)
+				{
+					reference = result;
+				}
+
+				float solveMs = result.velocityMs + result.positionMs + result.subStepsMs;
+				float speedup = (reference.velocityMs + reference.positionMs + reference.subStepsMs) / Max(solveMs, 1e-6f);
+
+				printf("%-20s %-14s %8u %14.3f %14.3f %14.3f %12.3f %7.2fx %11.4f %016llx%s\n", sceneNames[sceneIndex], stepModeNames[(int)stepMode],
+					(unsigned int)threadCount, result.velocityMs, result.positionMs, result.subStepsMs, result.physicsMs, speedup, result.averagePenetration,
+					result.stateHash, (result.stateHash == reference.stateHash) ? "" : " MISMATCH");
+
+				if (threadCount == maxThreads)
+				{
+					break;
+				}
+			}
+		}
+	}
+
+	gVars->pSceneManager->Reset();
+
+	return 0;
+}
\ No newline at end of file
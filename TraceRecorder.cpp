@@ -0,0 +1,181 @@
+#include "TraceRecorder.h"
+
+#include <stdio.h>
+
+#include "Maths.h"
+
+static thread_local CTraceRecorder*	t_recorder = nullptr;
+static thread_local void*			t_buffer = nullptr;
+
+CTraceRecorder::~CTraceRecorder()
+{
+	Stop();
+
+	ClearBuffers();
+	for (SThreadBuffer* buffer : m_buffers)
+	{
+		delete buffer->first;
+		delete buffer;
+	}
+}
+
+void	CTraceRecorder::Start(const std::string& path)
+{
+	if (IsRecording())
+	{
+		return;
+	}
+
+	ClearBuffers();
+
+	m_path = path;
+	m_startTicks = GetClockTicks();
+	m_recording.store(true, std::memory_order_release);
+}
+
+void	CTraceRecorder::Stop()
+{
+	if (!IsRecording())
+	{
+		return;
+	}
+
+	m_recording.store(false, std::memory_order_release);
+
+	if (Flush())
+	{
+		printf("Trace written to %s\n", m_path.c_str());
+	}
+	else
+	{
+		printf("Failed to write trace to %s\n", m_path.c_str());
+	}
+
+	ClearBuffers();
+}
+
+bool	CTraceRecorder::IsRecording() const
+{
+	return m_recording.load(std::memory_order_relaxed);
+}
+
+void	CTraceRecorder::AddEvent(const char* name, TClockTicks startTicks, TClockTicks endTicks)
+{
+	if (!IsRecording())
+	{
+		return;
+	}
+
+	SThreadBuffer* buffer = GetThreadBuffer();
+
+	// zones opened before Start() are clipped to the recording start
+	startTicks = Max(startTicks, m_startTicks);
+
+	SChunk* chunk = buffer->last;
+	size_t count = chunk->count.load(std::memory_order_relaxed);
+	if (count == EVENTS_PER_CHUNK)
+	{
+		SChunk* newChunk = CreateChunk();
+		chunk->next.store(newChunk, std::memory_order_release);
+		buffer->last = chunk = newChunk;
+		count = 0;
+	}
+
+	STraceEvent& event = chunk->events[count];
+	event.name = name;
+	event.startTicks = startTicks;
+	event.endTicks = endTicks;
+
+	// publish the event for Flush()
+	chunk->count.store(count + 1, std::memory_order_release);
+}
+
+CTraceRecorder::SThreadBuffer*	CTraceRecorder::GetThreadBuffer()
+{
+	if (t_recorder == this)
+	{
+		return static_cast<SThreadBuffer*>(t_buffer);
+	}
+
+	SThreadBuffer* buffer = new SThreadBuffer();
+	buffer->first = buffer->last = CreateChunk();
+
+	{
+		std::lock_guard<std::mutex> lock(m_buffersMutex);
+		buffer->threadIndex = m_buffers.size();
+		m_buffers.push_back(buffer);
+	}
+
+	t_recorder = this;
+	t_buffer = buffer;
+
+	return buffer;
+}
+
+CTraceRecorder::SChunk*	CTraceRecorder::CreateChunk()
+{
+	SChunk* chunk = new SChunk();
+	chunk->count.store(0, std::memory_order_relaxed);
+	chunk->next.store(nullptr, std::memory_order_relaxed);
+
+	return chunk;
+}
+
+bool	CTraceRecorder::Flush()
+{
+	FILE* file = fopen(m_path.c_str(), "w");
+	if (file == nullptr)
+	{
+		return false;
+	}
+
+	fprintf(file, "{\"traceEvents\":[\n");
+
+	bool first = true;
+
+	std::lock_guard<std::mutex> lock(m_buffersMutex);
+	for (SThreadBuffer* buffer : m_buffers)
+	{
+		fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":\"Thread %u\"}}", first ? "" : ",\n",
+			(unsigned int)buffer->threadIndex, (unsigned int)buffer->threadIndex);
+		first = false;
+
+		for (SChunk* chunk = buffer->first; chunk != nullptr; chunk = chunk->next.load(std::memory_order_acquire))
+		{
+			size_t count = chunk->count.load(std::memory_order_acquire);
+			for (size_t i = 0; i < count; ++i)
+			{
+				const STraceEvent& event = chunk->events[i];
+
+				// timestamps in microseconds
+				double start = (double)(event.startTicks - m_startTicks) * 1e-3;
+				double duration = (double)(event.endTicks - event.startTicks) * 1e-3;
+				fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", event.name, (unsigned int)buffer->threadIndex, start, duration);
+			}
+		}
+	}
+
+	fprintf(file, "\n]}\n");
+	fclose(file);
+
+	return true;
+}
+
+void	CTraceRecorder::ClearBuffers()
+{
+	std::lock_guard<std::mutex> lock(m_buffersMutex);
+	for (SThreadBuffer* buffer : m_buffers)
+	{
+		SChunk* chunk = buffer->first->next.load(std::memory_order_relaxed);
+		while (chunk != nullptr)
+		{
+			SChunk* next = chunk->next.load(std::memory_order_relaxed);
+			delete chunk;
+			chunk = next;
+		}
+
+		buffer->first->next.store(nullptr, std::memory_order_relaxed);
+		buffer->first->count.store(0, std::memory_order_relaxed);
+		buffer->last = buffer->first;
+	}
+}
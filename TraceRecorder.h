@@ -0,0 +1,94 @@
+#ifndef _TRACE_RECORDER_H_
+#define _TRACE_RECORDER_H_
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stddef.h>
+
+#include "Timer.h"
+#include "GlobalVariables.h"
+
+struct STraceEvent
+{
+	const char*	name;
+	TClockTicks	startTicks;
+	TClockTicks	endTicks;
+};
+
+// Records zone events into per-thread buffers and writes them as trace-event JSON
+// (chrome://tracing, Perfetto). Recording is lock-free, a thread only takes a lock
+// the first time it records. Stop() flushes the file and must be called while the
+// recording threads are idle (between frames).
+class CTraceRecorder
+{
+public:
+	~CTraceRecorder();
+
+	void	Start(const std::string& path);
+	void	Stop();
+	bool	IsRecording() const;
+
+	void	AddEvent(const char* name, TClockTicks startTicks, TClockTicks endTicks);
+
+private:
+	static const size_t EVENTS_PER_CHUNK = 4096;
+
+	struct SChunk
+	{
+		STraceEvent				events[EVENTS_PER_CHUNK];
+		std::atomic<size_t>		count;
+		std::atomic<SChunk*>	next;
+	};
+
+	// only written by its thread
+	struct SThreadBuffer
+	{
+		SChunk*	first;
+		SChunk*	last;
+		size_t	threadIndex;
+	};
+
+	SThreadBuffer*	GetThreadBuffer();
+	SChunk*			CreateChunk();
+	bool			Flush();
+	void			ClearBuffers();
+
+	std::atomic<bool>			m_recording{ false };
+	std::string					m_path;
+	TClockTicks					m_startTicks = 0;
+
+	std::mutex					m_buffersMutex; // thread registration only
+	std::vector<SThreadBuffer*>	m_buffers;
+};
+
+// Trace only scope, unlike PROFILE_ZONE it can be used from any thread
+class CTraceScope
+{
+public:
+	CTraceScope(const char* name)
+		: m_name(name), m_startTicks((gVars && gVars->pTraceRecorder && gVars->pTraceRecorder->IsRecording()) ? GetClockTicks() : 0){}
+
+	~CTraceScope()
+	{
+		if (m_startTicks != 0)
+		{
+			gVars->pTraceRecorder->AddEvent(m_name, m_startTicks, GetClockTicks());
+		}
+	}
+
+private:
+	const char*	m_name;
+	TClockTicks	m_startTicks;
+};
+
+#ifndef PHYSIC_NO_PROFILER
+#define TRACE_CONCAT_IMPL(a, b)	a##b
+#define TRACE_CONCAT(a, b)		TRACE_CONCAT_IMPL(a, b)
+#define TRACE_ZONE(name)		CTraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+#else
+#define TRACE_ZONE(name)
+#endif
+
+#endif
\ No newline at end of file
@@ -46,6 +46,28 @@ CPolygonPtr		CWorld::AddSymetricPolygon(float radius, size_t sides)
 	return poly;
 }
 
+CPolygonPtr		CWorld::AddCircle(float radius)
+{
+	CPolygonPtr poly = AddPolygon();
+	poly->m_shapeType = EShapeType::Circle;
+	poly->m_radius = radius;
+	poly->Build();
+
+	return poly;
+}
+
+CPolygonPtr		CWorld::AddCapsule(float length, float radius)
+{
+	CPolygonPtr poly = AddPolygon();
+	poly->m_shapeType = EShapeType::Capsule;
+	poly->m_radius = radius;
+	poly->points.push_back({ -length * 0.5f, 0.0f });
+	poly->points.push_back({ length * 0.5f, 0.0f });
+	poly->Build();
+
+	return poly;
+}
+
 CPolygonPtr		CWorld::AddRandomPoly(const SRandomPolyParams& params)
 {
 	size_t pointsCount = (size_t)Random(params.minPoints, params.maxPoints);
@@ -91,6 +113,7 @@ void	CWorld::RemovePolygon(CPolygonPtr poly)
 		m_polygons[index] = movedPoly;
 		movedPoly->m_index = index;
 	}
+	m_polygons.pop_back();
 }
 
 void	CWorld::RemoveBehavior(CBehaviorPtr behavior)
@@ -102,12 +125,13 @@ void	CWorld::RemoveBehavior(CBehaviorPtr behavior)
 
 	size_t index = behavior->m_index;
 
-	if (index + 1 < m_polygons.size())
+	if (index + 1 < m_behaviors.size())
 	{
 		CBehaviorPtr movedBhv = m_behaviors[m_behaviors.size() - 1];
 		m_behaviors[index] = movedBhv;
 		movedBhv->m_index = index;
 	}
+	m_behaviors.pop_back();
 }
 
 size_t	CWorld::GetPolygonCount() const
@@ -21,6 +21,8 @@ public:
 	CPolygonPtr		AddRectangle(float width, float height);
 	CPolygonPtr		AddSquare(float size);
 	CPolygonPtr		AddSymetricPolygon(float radius, size_t sides);
+	CPolygonPtr		AddCircle(float radius);
+	CPolygonPtr		AddCapsule(float length, float radius); // length between the centers of the ends, along X
 	CPolygonPtr		AddRandomPoly(const SRandomPolyParams& params);
 
 	CPolygonPtr		AddPolygon();